@@ -0,0 +1,172 @@
+#include "Betweenness.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+// Сколько памяти можно отдать под копии рабочих массивов, если раздавать источники по потокам
+constexpr size_t SCRATCH_BUDGET = size_t{1} << 30;
+constexpr size_t SCRATCH_BYTES_PER_VERTEX = sizeof(int) * 2 + sizeof(double) * 3;
+} // namespace
+
+std::vector<double> BetweennessAnalyzer::exact(const Graph &g)
+{
+    std::vector<int> sources(g.vertices());
+    std::iota(sources.begin(), sources.end(), 0);
+    return run(g, sources);
+}
+
+std::vector<double> BetweennessAnalyzer::sampled(const Graph &g, std::mt19937_64 &r, int sourceCount)
+{
+    const int n = g.vertices();
+    sourceCount = std::clamp(sourceCount, 0, n);
+    if (sourceCount == 0)
+        return std::vector<double>(n, 0.0);
+
+    // Частичная перетасовка Фишера-Йетса: первые sourceCount элементов - выборка без повторов
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    for (int i = 0; i < sourceCount; ++i) {
+        std::uniform_int_distribution<int> jdist(i, n - 1);
+        std::swap(perm[i], perm[jdist(r)]);
+    }
+    perm.resize(sourceCount);
+
+    auto centrality = run(g, perm);
+    const double scale = static_cast<double>(n) / sourceCount;
+    for (double &c : centrality) {
+        c *= scale;
+    }
+    return centrality;
+}
+
+std::vector<double> BetweennessAnalyzer::run(const Graph &g, const std::vector<int> &sources)
+{
+    const size_t n = static_cast<size_t>(g.vertices());
+    const size_t threads = threadCount();
+    std::vector<double> centrality(n, 0.0);
+
+    // Много источников и граф помещается в память threads раз - параллелим по источникам без синхронизации,
+    // иначе обходим источники по одному, а параллелим внутри каждого уровня
+    if (sources.size() >= threads && threads > 1 && n * threads * SCRATCH_BYTES_PER_VERTEX <= SCRATCH_BUDGET) {
+        br::Mutex<std::vector<double>> total(n, 0.0);
+        parallelFor(0, sources.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            Scratch scratch;
+            scratch.depth.assign(n, -1);
+            scratch.sigma.assign(n, 0.0);
+            scratch.delta.assign(n, 0.0);
+            std::vector<double> local(n, 0.0);
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                accumulateSerial(g, sources[i], scratch, local);
+            }
+            auto t = total.Lock();
+            for (size_t v = 0; v < n; ++v) {
+                (*t)[v] += local[v];
+            }
+        });
+        centrality = std::move(*total.Lock());
+    } else {
+        for (int source : sources) {
+            accumulateParallel(g, source, centrality);
+        }
+    }
+    return centrality;
+}
+
+void BetweennessAnalyzer::accumulateSerial(const Graph &g, int source, Scratch &scratch,
+                                           std::vector<double> &centrality)
+{
+    auto &[order, depth, sigma, delta] = scratch;
+    order.clear();
+    order.push_back(source);
+    depth[source] = 0;
+    sigma[source] = 1.0;
+
+    for (size_t head = 0; head < order.size(); ++head) {
+        int u = order[head];
+        for (int v : g.neighbors(u)) {
+            if (depth[v] < 0) {
+                depth[v] = depth[u] + 1;
+                order.push_back(v);
+            }
+            if (depth[v] == depth[u] + 1) {
+                sigma[v] += sigma[u];
+            }
+        }
+    }
+
+    // Обратный порядок обхода - это уровни от самого глубокого, преемники уже посчитаны
+    for (size_t i = order.size(); i-- > 0;) {
+        int w = order[i];
+        double dependency = 0.0;
+        for (int v : g.neighbors(w)) {
+            if (depth[v] == depth[w] + 1) {
+                dependency += sigma[w] / sigma[v] * (1.0 + delta[v]);
+            }
+        }
+        delta[w] = dependency;
+        if (w != source) {
+            centrality[w] += dependency;
+        }
+    }
+
+    // Сбрасываем только то, что трогали, чтобы следующий источник не платил O(V)
+    for (int v : order) {
+        depth[v] = -1;
+        sigma[v] = 0.0;
+        delta[v] = 0.0;
+    }
+}
+
+void BetweennessAnalyzer::accumulateParallel(const Graph &g, int source, std::vector<double> &centrality)
+{
+    const int n = g.vertices();
+    std::vector<std::atomic<int>> depth(n);
+    std::vector<std::atomic<double>> sigma(n);
+    std::vector<double> delta(n, 0.0);
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t v = chunkStart; v < chunkEnd; ++v) {
+            depth[v].store(-1, std::memory_order_relaxed);
+            sigma[v].store(0.0, std::memory_order_relaxed);
+        }
+    });
+    depth[source].store(0, std::memory_order_relaxed);
+    sigma[source].store(1.0, std::memory_order_relaxed);
+
+    // Фронты сохраняем по уровням, sigma вершины уровня d окончательна, пока строится уровень d + 1
+    std::vector<std::vector<int>> levels{{source}};
+    for (int d = 0; !levels.back().empty(); ++d) {
+        levels.push_back(expandFrontier(levels.back(), [&](int u) { return g.neighbors(u); }, [&](int u, int v) {
+            int expected = -1;
+            bool discovered = depth[v].compare_exchange_strong(expected, d + 1, std::memory_order_relaxed);
+            if (discovered || expected == d + 1) {
+                sigma[v].fetch_add(sigma[u].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            return discovered;
+        }));
+    }
+    levels.pop_back();
+
+    // Зависимость вершины собирается с ее преемников, поэтому записи не пересекаются и атомики не нужны
+    for (size_t d = levels.size(); d-- > 0;) {
+        const auto &level = levels[d];
+        parallelFor(0, level.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                int w = level[i];
+                double sigmaW = sigma[w].load(std::memory_order_relaxed);
+                double dependency = 0.0;
+                for (int v : g.neighbors(w)) {
+                    if (depth[v].load(std::memory_order_relaxed) == static_cast<int>(d) + 1) {
+                        dependency += sigmaW / sigma[v].load(std::memory_order_relaxed) * (1.0 + delta[v]);
+                    }
+                }
+                delta[w] = dependency;
+                if (w != source) {
+                    centrality[w] += dependency;
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <random>
+#include <vector>
+#include "Graph.h"
+
+class BetweennessAnalyzer {
+public:
+    // Точная центральность по Брандесу: BFS из каждой вершины и накопление зависимостей по уровням
+    std::vector<double> exact(const Graph &g);
+    // Оценка по sourceCount случайным источникам, масштабированная на n / sourceCount
+    std::vector<double> sampled(const Graph &g, std::mt19937_64 &r, int sourceCount);
+
+private:
+    struct Scratch {
+        std::vector<int> order; // вершины в порядке обхода, то есть по неубыванию глубины
+        std::vector<int> depth;
+        std::vector<double> sigma; // число кратчайших путей от источника
+        std::vector<double> delta;
+    };
+
+    static std::vector<double> run(const Graph &g, const std::vector<int> &sources);
+    static void accumulateSerial(const Graph &g, int source, Scratch &scratch, std::vector<double> &centrality);
+    static void accumulateParallel(const Graph &g, int source, std::vector<double> &centrality);
+};
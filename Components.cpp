@@ -0,0 +1,268 @@
+#include "Components.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <span>
+#include <unordered_map>
+
+namespace {
+constexpr int NEIGHBOR_ROUNDS = 2; // сколько первых соседей каждой вершины связываем до сжатия
+constexpr int GIANT_SAMPLES = 1024; // по скольким случайным вершинам ищем самую большую компоненту
+constexpr int TRIM_ROUNDS = 3;
+constexpr int UNASSIGNED = -1;
+
+// Подвешиваем больший корень под меньший, поэтому циклов в лесе не бывает
+void link(int u, int v, std::vector<std::atomic<int>> &comp)
+{
+    int p1 = comp[u].load(std::memory_order_relaxed);
+    int p2 = comp[v].load(std::memory_order_relaxed);
+    while (p1 != p2) {
+        int high = std::max(p1, p2);
+        int low = std::min(p1, p2);
+        int pHigh = comp[high].load(std::memory_order_relaxed);
+        if (pHigh == low)
+            break;
+        if (pHigh == high && comp[high].compare_exchange_strong(pHigh, low, std::memory_order_relaxed))
+            break;
+        p1 = comp[comp[high].load(std::memory_order_relaxed)].load(std::memory_order_relaxed);
+        p2 = comp[low].load(std::memory_order_relaxed);
+    }
+}
+
+void compress(std::vector<std::atomic<int>> &comp)
+{
+    parallelFor(0, comp.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t n = chunkStart; n < chunkEnd; ++n) {
+            int parent = comp[n].load(std::memory_order_relaxed);
+            while (parent != comp[parent].load(std::memory_order_relaxed)) {
+                parent = comp[parent].load(std::memory_order_relaxed);
+                comp[n].store(parent, std::memory_order_relaxed);
+            }
+        }
+    });
+}
+
+// Атомарный максимум, true если значение увеличилось
+bool atomicMax(std::atomic<int> &target, int value)
+{
+    int current = target.load(std::memory_order_relaxed);
+    while (current < value) {
+        if (target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+// Параллельный фильтр, порядок вершин в результате не сохраняется
+template <typename Keep>
+std::vector<int> filterVertices(const std::vector<int> &vertices, Keep &&keep)
+{
+    br::Mutex<std::vector<int>> result;
+    parallelFor(0, vertices.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        std::vector<int> local;
+        for (size_t i = chunkStart; i < chunkEnd; ++i) {
+            if (keep(vertices[i]))
+                local.push_back(vertices[i]);
+        }
+        auto r = result.Lock();
+        r->insert(r->end(), local.begin(), local.end());
+    });
+    return std::move(*result.Lock());
+}
+} // namespace
+
+Components ComponentAnalyzer::weaklyConnected(const Graph &g)
+{
+    const int n = g.vertices();
+    std::vector<std::atomic<int>> comp(n);
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t i = chunkStart; i < chunkEnd; ++i) {
+            comp[i].store(static_cast<int>(i), std::memory_order_relaxed);
+        }
+    });
+
+    // Afforest: сначала связываем несколько первых соседей и сжимаем, после чего большая часть
+    // оставшихся ребер отсекается в link сразу, потому что концы уже лежат в одном дереве
+    for (int round = 0; round < NEIGHBOR_ROUNDS; ++round) {
+        parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            for (size_t u = chunkStart; u < chunkEnd; ++u) {
+                auto row = g.neighbors(static_cast<int>(u));
+                if (static_cast<size_t>(round) < row.size())
+                    link(static_cast<int>(u), row[round], comp);
+            }
+        });
+        compress(comp);
+    }
+
+    // Без входящих ребер строки вершин из самой большой компоненты пропустить нельзя: ребро u -> v
+    // больше никто не увидит. С ними ребро из гигантской компоненты в v найдется по входящим ребрам v,
+    // так что вершины гигантской компоненты не просматриваются вовсе
+    int giant = -1;
+    if (g.hasInEdges() && n > 0) {
+        std::mt19937 rnd(n);
+        std::uniform_int_distribution<int> vertex(0, n - 1);
+        std::unordered_map<int, int> frequency;
+        for (int i = 0; i < GIANT_SAMPLES; ++i) {
+            ++frequency[comp[vertex(rnd)].load(std::memory_order_relaxed)];
+        }
+        giant = std::max_element(frequency.begin(), frequency.end(), [](const auto &a, const auto &b) {
+                    return a.second < b.second;
+                })->first;
+    }
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            if (giant >= 0) {
+                if (comp[u].load(std::memory_order_relaxed) == giant)
+                    continue;
+                // В неориентированном графе входящие ребра совпадают с исходящими, их обойдет цикл ниже
+                for (int w : g.isSymmetric() ? std::span<const int>() : g.inNeighbors(static_cast<int>(u))) {
+                    link(static_cast<int>(u), w, comp);
+                }
+            }
+            auto row = g.neighbors(static_cast<int>(u));
+            for (size_t i = NEIGHBOR_ROUNDS; i < row.size(); ++i) {
+                link(static_cast<int>(u), row[i], comp);
+            }
+        }
+    });
+    compress(comp);
+
+    std::vector<int> labels(n);
+    for (int i = 0; i < n; ++i) {
+        labels[i] = comp[i].load(std::memory_order_relaxed);
+    }
+    return finalize(labels);
+}
+
+Components ComponentAnalyzer::stronglyConnected(const Graph &g)
+{
+    if (g.isSymmetric())
+        return weaklyConnected(g); // в неориентированном графе сильная связность совпадает со слабой
+    const int n = g.vertices();
+    Graph reverse = g; // копия делит массивы с g, своими будут только входящие ребра
+    if (!reverse.hasInEdges())
+        reverse.buildInEdges();
+    auto inNeighbors = [&](int u) { return reverse.inNeighbors(u); };
+    auto outNeighbors = [&](int u) { return g.neighbors(u); };
+
+    std::vector<std::atomic<int>> scc(n);
+    for (int i = 0; i < n; ++i) {
+        scc[i].store(UNASSIGNED, std::memory_order_relaxed);
+    }
+    auto active = [&](int v) { return scc[v].load(std::memory_order_relaxed) == UNASSIGNED; };
+    std::vector<int> remaining(n);
+    std::iota(remaining.begin(), remaining.end(), 0);
+
+    // Trim: вершина без активных входящих или исходящих ребер сама по себе компонента
+    for (int round = 0; round < TRIM_ROUNDS && !remaining.empty(); ++round) {
+        size_t before = remaining.size();
+        auto hasActive = [&](std::span<const int> row) {
+            return std::any_of(row.begin(), row.end(), [&](int w) { return active(w); });
+        };
+        std::vector<int> trimmed = filterVertices(remaining, [&](int v) {
+            return !hasActive(outNeighbors(v)) || !hasActive(inNeighbors(v));
+        });
+        for (int v : trimmed) {
+            scc[v].store(v, std::memory_order_relaxed);
+        }
+        remaining = filterVertices(remaining, active);
+        if (remaining.size() == before)
+            break;
+    }
+
+    // Forward-backward от вершины с максимальным deg_in * deg_out: обычно сразу снимает гигантскую компоненту
+    if (!remaining.empty()) {
+        int pivot = *std::max_element(remaining.begin(), remaining.end(), [&](int a, int b) {
+            return outNeighbors(a).size() * inNeighbors(a).size() < outNeighbors(b).size() * inNeighbors(b).size();
+        });
+        std::vector<std::atomic<bool>> forward(n);
+        forward[pivot].store(true, std::memory_order_relaxed);
+        std::vector<int> frontier{pivot};
+        while (!frontier.empty()) {
+            frontier = expandFrontier(frontier, outNeighbors, [&](int, int v) {
+                bool expected = false;
+                return active(v) &&
+                       forward[v].compare_exchange_strong(expected, true, std::memory_order_relaxed);
+            });
+        }
+        // Обратный обход ограничен прямым множеством, значит он и дает пересечение F и B
+        scc[pivot].store(pivot, std::memory_order_relaxed);
+        frontier = {pivot};
+        while (!frontier.empty()) {
+            frontier = expandFrontier(frontier, inNeighbors, [&](int, int v) {
+                int expected = UNASSIGNED;
+                return forward[v].load(std::memory_order_relaxed) &&
+                       scc[v].compare_exchange_strong(expected, pivot, std::memory_order_relaxed);
+            });
+        }
+        remaining = filterVertices(remaining, active);
+    }
+
+    // Раскраска: распространяем максимальный номер вдоль ребер, корень цвета c - вершина c,
+    // а его компонента - вершины цвета c, из которых c достижима
+    std::vector<std::atomic<int>> color(n);
+    std::vector<std::atomic<int>> stamp(n);
+    int round = 0;
+    while (!remaining.empty()) {
+        for (int v : remaining) {
+            color[v].store(v, std::memory_order_relaxed);
+        }
+        std::vector<int> frontier = remaining;
+        while (!frontier.empty()) {
+            ++round;
+            frontier = expandFrontier(frontier, outNeighbors, [&](int u, int v) {
+                return active(v) && atomicMax(color[v], color[u].load(std::memory_order_relaxed)) &&
+                       stamp[v].exchange(round, std::memory_order_relaxed) != round;
+            });
+        }
+
+        std::vector<int> roots = filterVertices(remaining, [&](int v) {
+            return color[v].load(std::memory_order_relaxed) == v;
+        });
+        for (int r : roots) {
+            scc[r].store(r, std::memory_order_relaxed);
+        }
+        frontier = std::move(roots);
+        while (!frontier.empty()) {
+            frontier = expandFrontier(frontier, inNeighbors, [&](int u, int v) {
+                int c = color[u].load(std::memory_order_relaxed);
+                int expected = UNASSIGNED;
+                return color[v].load(std::memory_order_relaxed) == c &&
+                       scc[v].compare_exchange_strong(expected, c, std::memory_order_relaxed);
+            });
+        }
+        remaining = filterVertices(remaining, active);
+    }
+
+    std::vector<int> labels(n);
+    for (int i = 0; i < n; ++i) {
+        labels[i] = scc[i].load(std::memory_order_relaxed);
+    }
+    return finalize(labels);
+}
+
+Components ComponentAnalyzer::finalize(const std::vector<int> &labels)
+{
+    const size_t n = labels.size();
+    Components result;
+    result.componentId.resize(n);
+
+    // Метка - номер какой-то вершины компоненты, переводим в плотные номера по порядку первой вершины
+    std::vector<int> dense(n, -1);
+    for (size_t v = 0; v < n; ++v) {
+        int &id = dense[labels[v]];
+        if (id < 0) {
+            id = static_cast<int>(result.componentSizes.size());
+            result.componentSizes.push_back(0);
+        }
+        result.componentId[v] = id;
+        ++result.componentSizes[id];
+    }
+    for (int size : result.componentSizes) {
+        ++result.sizeHistogram[size];
+    }
+    return result;
+}
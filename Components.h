@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "Graph.h"
+
+struct Components {
+    std::vector<int> componentId;     // плотный номер компоненты 0..count()-1 для каждой вершины
+    std::vector<int> componentSizes;  // размер компоненты по ее номеру
+    std::map<int, int> sizeHistogram; // размер компоненты -> сколько компонент такого размера
+
+    [[nodiscard]] int count() const
+    {
+        return static_cast<int>(componentSizes.size());
+    }
+};
+
+class ComponentAnalyzer {
+public:
+    // Слабые компоненты: union-find в стиле Afforest/Shiloach-Vishkin со сжатием путей.
+    // Если у графа есть входящие ребра, строки вершин самой большой компоненты пропускаются
+    Components weaklyConnected(const Graph &g);
+    // Сильные компоненты: trim, forward-backward от опорной вершины и раскраска поверх expandFrontier.
+    // Нужны входящие ребра: если граф их не хранит, они строятся на время вызова.
+    // Для неориентированного графа сводится к слабым компонентам
+    Components stronglyConnected(const Graph &g);
+
+private:
+    static Components finalize(const std::vector<int> &labels);
+};
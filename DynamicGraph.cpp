@@ -0,0 +1,303 @@
+#include "DynamicGraph.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+// Журнал сворачивается, когда в нем больше 1/COMPACTION_FRACTION ребер базы, но не раньше MIN_COMPACTION записей
+constexpr int64_t COMPACTION_FRACTION = 8;
+constexpr int64_t MIN_COMPACTION = 1 << 16;
+
+// Индексы пакета, упорядоченные по ключу с сохранением порядка пакета, и границы групп с одинаковым ключом
+template <typename Key>
+std::vector<size_t> groupBy(std::vector<size_t> &indices, Key &&key)
+{
+    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+    std::vector<size_t> starts;
+    for (size_t k = 0; k < indices.size(); ++k) {
+        if (k == 0 || key(indices[k]) != key(indices[k - 1]))
+            starts.push_back(k);
+    }
+    starts.push_back(indices.size());
+    return starts;
+}
+} // namespace
+
+DynamicGraph::DynamicGraph(Graph base)
+    : base_(std::move(base)), out_(base_.vertices()), in_(base_.vertices()), edgeCount_(base_.edges())
+{
+    if (!base_.hasInEdges())
+        base_.buildInEdges();
+}
+
+std::vector<EdgeUpdate> DynamicGraph::apply(std::span<const EdgeUpdate> batch)
+{
+    const int n = vertices();
+    std::vector<size_t> indices;
+    indices.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const auto &e = batch[i];
+        if (e.src >= 0 && e.src < n && e.dest >= 0 && e.dest < n)
+            indices.push_back(i);
+    }
+
+    // Сначала исходящая сторона: она решает, меняет ли обновление граф. Каждую вершину
+    // обрабатывает одна задача, поэтому ее журнал правится без синхронизации
+    std::vector<char> effective(batch.size(), 0);
+    std::atomic<int64_t> pending = 0;
+    std::atomic<int64_t> edgeChange = 0;
+    auto starts = groupBy(indices, [&](size_t i) { return batch[i].src; });
+    parallelFor(0, starts.size() - 1, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        int64_t localPending = 0;
+        int64_t localEdges = 0;
+        for (size_t group = chunkStart; group < chunkEnd; ++group) {
+            int u = batch[indices[starts[group]]].src;
+            Delta &delta = out_[u];
+            auto before = static_cast<int64_t>(delta.added.size() + delta.removed.size());
+            for (size_t k = starts[group]; k < starts[group + 1]; ++k) {
+                const auto &e = batch[indices[k]];
+                if (applyTo(delta, base_.neighbors(u), e.kind, e.dest)) {
+                    effective[indices[k]] = 1;
+                    localEdges += e.kind == EdgeUpdate::Kind::INSERT ? 1 : -1;
+                }
+            }
+            localPending += static_cast<int64_t>(delta.added.size() + delta.removed.size()) - before;
+        }
+        pending.fetch_add(localPending, std::memory_order_relaxed);
+        edgeChange.fetch_add(localEdges, std::memory_order_relaxed);
+    });
+
+    // Входящая сторона повторяет только действующие обновления, в том же порядке для каждого ребра
+    std::erase_if(indices, [&](size_t i) { return !effective[i]; });
+    std::vector<EdgeUpdate> applied;
+    applied.reserve(indices.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (effective[i])
+            applied.push_back(batch[i]);
+    }
+    starts = groupBy(indices, [&](size_t i) { return batch[i].dest; });
+    parallelFor(0, starts.size() - 1, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t group = chunkStart; group < chunkEnd; ++group) {
+            int v = batch[indices[starts[group]]].dest;
+            for (size_t k = starts[group]; k < starts[group + 1]; ++k) {
+                const auto &e = batch[indices[k]];
+                applyTo(in_[v], base_.inNeighbors(v), e.kind, e.src);
+            }
+        }
+    });
+
+    pendingChanges_ += pending.load(std::memory_order_relaxed);
+    edgeCount_ += edgeChange.load(std::memory_order_relaxed);
+    if (pendingChanges_ > std::max(MIN_COMPACTION, base_.edges() / COMPACTION_FRACTION))
+        compact();
+    return applied;
+}
+
+void DynamicGraph::compact()
+{
+    if (pendingChanges_ == 0)
+        return;
+    const int n = vertices();
+    br::HugeVector<int64_t> offsets(static_cast<size_t>(n) + 1, 0);
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            const Delta &delta = out_[u];
+            offsets[u + 1] = static_cast<int64_t>(base_.neighbors(static_cast<int>(u)).size() + delta.added.size() -
+                                                  delta.removed.size());
+        }
+    });
+    for (int u = 0; u < n; ++u) {
+        offsets[u + 1] += offsets[u];
+    }
+    br::HugeVector<int> targets(static_cast<size_t>(offsets[n]));
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            int64_t cursor = offsets[u];
+            forEachNeighbor(static_cast<int>(u), [&](int v) { targets[cursor++] = v; });
+            out_[u] = {};
+            in_[u] = {};
+        }
+    });
+
+    Graph next(n, std::move(offsets), std::move(targets));
+    next.buildInEdges();
+    base_ = std::move(next);
+    pendingChanges_ = 0;
+}
+
+int DynamicGraph::vertices() const
+{
+    return base_.vertices();
+}
+
+int64_t DynamicGraph::edges() const
+{
+    return edgeCount_;
+}
+
+int64_t DynamicGraph::pendingChanges() const
+{
+    return pendingChanges_;
+}
+
+bool DynamicGraph::hasEdge(int src, int dest) const
+{
+    if (src < 0 || dest < 0 || src >= vertices() || dest >= vertices())
+        return false;
+    const Delta &delta = out_[src];
+    if (contains(delta.added, dest))
+        return true;
+    return !contains(delta.removed, dest) && contains(base_.neighbors(src), dest);
+}
+
+const Graph &DynamicGraph::base() const
+{
+    return base_;
+}
+
+bool DynamicGraph::contains(std::span<const int> values, int value)
+{
+    return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+bool DynamicGraph::erase(std::vector<int> &values, int value)
+{
+    auto it = std::find(values.begin(), values.end(), value);
+    if (it == values.end())
+        return false;
+    *it = values.back();
+    values.pop_back();
+    return true;
+}
+
+bool DynamicGraph::applyTo(Delta &delta, std::span<const int> row, EdgeUpdate::Kind kind, int other)
+{
+    if (kind == EdgeUpdate::Kind::INSERT) {
+        // Вставка удаленного ребра базы просто снимает пометку
+        if (erase(delta.removed, other))
+            return true;
+        if (contains(row, other) || contains(delta.added, other))
+            return false;
+        delta.added.push_back(other);
+        return true;
+    }
+    if (erase(delta.added, other))
+        return true;
+    if (contains(delta.removed, other) || !contains(row, other))
+        return false;
+    delta.removed.push_back(other);
+    return true;
+}
+
+IncrementalBfs::IncrementalBfs(const DynamicGraph &g, int root)
+    : g_(g), root_(root), distance_(g.vertices(), -1), parent_(g.vertices(), -1), inRegion_(g.vertices(), 0)
+{
+    if (root < 0 || root >= g.vertices())
+        return;
+    distance_[root] = 0;
+    parent_[root] = root;
+    std::vector<std::vector<int>> buckets;
+    push(buckets, root);
+    propagate(buckets);
+}
+
+size_t IncrementalBfs::update(std::span<const EdgeUpdate> applied)
+{
+    if (root_ < 0 || root_ >= g_.vertices())
+        return 0;
+
+    // Удаленные ребра дерева: под ними все поддерево теряет расстояния. Ребро, вставленное
+    // обратно в том же пакете, дерево не рвет
+    std::vector<int> region;
+    for (const auto &e : applied) {
+        if (e.kind == EdgeUpdate::Kind::REMOVE && e.dest != root_ && parent_[e.dest] == e.src &&
+            !inRegion_[e.dest] && !g_.hasEdge(e.src, e.dest)) {
+            inRegion_[e.dest] = 1;
+            region.push_back(e.dest);
+        }
+    }
+    for (size_t i = 0; i < region.size(); ++i) {
+        int s = region[i];
+        g_.forEachNeighbor(s, [&](int w) {
+            if (!inRegion_[w] && parent_[w] == s && w != root_) {
+                inRegion_[w] = 1;
+                region.push_back(w);
+            }
+        });
+    }
+    for (int r : region) {
+        distance_[r] = -1;
+        parent_[r] = -1;
+    }
+
+    // Вершины вне области сохранили кратчайшие пути, поэтому область заново заходит только от них
+    std::vector<std::vector<int>> buckets;
+    for (int r : region) {
+        g_.forEachInNeighbor(r, [&](int x) {
+            if (!inRegion_[x] && distance_[x] >= 0 && (distance_[r] < 0 || distance_[x] + 1 < distance_[r])) {
+                distance_[r] = distance_[x] + 1;
+                parent_[r] = x;
+            }
+        });
+        if (distance_[r] >= 0)
+            push(buckets, r);
+    }
+    for (int r : region) {
+        inRegion_[r] = 0;
+    }
+    size_t changed = region.size() + propagate(buckets);
+
+    // Вставки только укорачивают пути: улучшения расходятся от концов новых ребер
+    buckets.clear();
+    for (const auto &e : applied) {
+        if (e.kind != EdgeUpdate::Kind::INSERT || distance_[e.src] < 0 || !g_.hasEdge(e.src, e.dest))
+            continue;
+        if (distance_[e.dest] < 0 || distance_[e.src] + 1 < distance_[e.dest]) {
+            distance_[e.dest] = distance_[e.src] + 1;
+            parent_[e.dest] = e.src;
+            push(buckets, e.dest);
+            ++changed;
+        }
+    }
+    return changed + propagate(buckets);
+}
+
+const std::vector<int> &IncrementalBfs::distances() const
+{
+    return distance_;
+}
+
+const std::vector<int> &IncrementalBfs::parents() const
+{
+    return parent_;
+}
+
+size_t IncrementalBfs::propagate(std::vector<std::vector<int>> &buckets)
+{
+    size_t changed = 0;
+    for (size_t d = 0; d < buckets.size(); ++d) {
+        for (size_t i = 0; i < buckets[d].size(); ++i) {
+            int x = buckets[d][i];
+            if (distance_[x] != static_cast<int>(d))
+                continue; // запись устарела: вершину уже улучшили
+            g_.forEachNeighbor(x, [&](int w) {
+                if (distance_[w] < 0 || distance_[w] > static_cast<int>(d) + 1) {
+                    distance_[w] = static_cast<int>(d) + 1;
+                    parent_[w] = x;
+                    push(buckets, w);
+                    ++changed;
+                }
+            });
+        }
+    }
+    return changed;
+}
+
+void IncrementalBfs::push(std::vector<std::vector<int>> &buckets, int vertex)
+{
+    auto d = static_cast<size_t>(distance_[vertex]);
+    if (d >= buckets.size())
+        buckets.resize(d + 1);
+    buckets[d].push_back(vertex);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Graph.h"
+
+struct EdgeUpdate {
+    enum class Kind : uint8_t { INSERT = 0, REMOVE };
+
+    Kind kind;
+    int src;
+    int dest;
+};
+
+// Изменяемый ориентированный граф: неизменяемый CSR с входящими ребрами плюс журнал изменений
+// по вершинам (добавленные ребра и удаленные ребра базы). Когда журнал дорастает до доли базы,
+// он сворачивается в новый CSR. Чтение (соседи, обходы) не должно идти одновременно с apply.
+// Веса ребер и неориентированность базы при свертке не сохраняются
+class DynamicGraph {
+public:
+    explicit DynamicGraph(Graph base);
+
+    // Применяет пакет: обновления одной вершины идут в порядке пакета, разные вершины - параллельно.
+    // Возвращает обновления, которые действительно изменили граф (повторная вставка или удаление
+    // несуществующего ребра отбрасываются), в порядке пакета
+    std::vector<EdgeUpdate> apply(std::span<const EdgeUpdate> batch);
+    // Сворачивает журнал в новый CSR и перестраивает входящие ребра
+    void compact();
+
+    [[nodiscard]] int vertices() const;
+    [[nodiscard]] int64_t edges() const;
+    [[nodiscard]] int64_t pendingChanges() const; // записей в журнале
+    [[nodiscard]] bool hasEdge(int src, int dest) const;
+    // CSR без журнала: весь текущий граф он содержит только сразу после compact()
+    [[nodiscard]] const Graph &base() const;
+
+    template <typename F>
+    void forEachNeighbor(int vertex, F &&f) const
+    {
+        forEach(base_.neighbors(vertex), out_[vertex], f);
+    }
+
+    template <typename F>
+    void forEachInNeighbor(int vertex, F &&f) const
+    {
+        forEach(base_.inNeighbors(vertex), in_[vertex], f);
+    }
+
+private:
+    // removed - только ребра базы; ребро, добавленное и затем удаленное, просто уходит из added
+    struct Delta {
+        std::vector<int> added;
+        std::vector<int> removed;
+    };
+
+    template <typename F>
+    static void forEach(std::span<const int> row, const Delta &delta, F &f)
+    {
+        for (int v : row) {
+            if (delta.removed.empty() || !contains(delta.removed, v))
+                f(v);
+        }
+        for (int v : delta.added) {
+            f(v);
+        }
+    }
+
+    static bool contains(std::span<const int> values, int value);
+    static bool erase(std::vector<int> &values, int value);
+    // Применяет обновление к одной стороне, true если оно что-то изменило
+    static bool applyTo(Delta &delta, std::span<const int> row, EdgeUpdate::Kind kind, int other);
+
+    Graph base_;
+    std::vector<Delta> out_;
+    std::vector<Delta> in_;
+    int64_t edgeCount_;
+    int64_t pendingChanges_ = 0;
+};
+
+// BFS-дерево из одного корня, которое после каждого пакета чинится только в затронутой области:
+// удаление ребра дерева пересчитывает поддерево под ним от входящих ребер извне, вставка
+// распространяет улучшения от нового ребра. parent корня - он сам, у недостижимых -1
+class IncrementalBfs {
+public:
+    IncrementalBfs(const DynamicGraph &g, int root);
+
+    // applied - результат DynamicGraph::apply для уже примененного пакета.
+    // Возвращает, сколько вершин пришлось пересчитать
+    size_t update(std::span<const EdgeUpdate> applied);
+
+    [[nodiscard]] const std::vector<int> &distances() const;
+    [[nodiscard]] const std::vector<int> &parents() const;
+
+private:
+    // Вершины корзины d лежат на расстоянии d: алгоритм Дейкстры для единичных весов.
+    // Обрабатывает корзины по возрастанию, релаксируя исходящие ребра
+    size_t propagate(std::vector<std::vector<int>> &buckets);
+    void push(std::vector<std::vector<int>> &buckets, int vertex);
+
+    const DynamicGraph &g_;
+    int root_;
+    std::vector<int> distance_;
+    std::vector<int> parent_;
+    std::vector<char> inRegion_; // поддерево под удаленными ребрами, сбрасывается только в тронутых вершинах
+};
@@ -0,0 +1,114 @@
+#include "EdgeStream.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <stdexcept>
+
+EdgeStream::EdgeStream(int vertices, std::span<const uint64_t> edges) : vertexCount_(vertices)
+{
+    // Один проход подсчета и один раскладки: порядок ребер внутри раздела не важен
+    const int partitions = (vertices + STREAM_PARTITION_VERTICES - 1) / STREAM_PARTITION_VERTICES;
+    partitionStarts_.assign(static_cast<size_t>(partitions) + 1, 0);
+    for (uint64_t key : edges) {
+        auto src = static_cast<uint32_t>(key >> 32);
+        auto dest = static_cast<uint32_t>(key);
+        if (src >= static_cast<uint32_t>(vertices) || dest >= static_cast<uint32_t>(vertices))
+            throw std::invalid_argument("Edge endpoint is out of range");
+        ++partitionStarts_[partitionOf(static_cast<int>(src)) + 1];
+    }
+    for (int p = 0; p < partitions; ++p) {
+        partitionStarts_[p + 1] += partitionStarts_[p];
+    }
+    edges_.resize(edges.size());
+    std::vector<size_t> cursor(partitionStarts_.begin(), partitionStarts_.end() - 1);
+    for (uint64_t key : edges) {
+        edges_[cursor[partitionOf(static_cast<int>(key >> 32))]++] = key;
+    }
+}
+
+EdgeStream EdgeStream::fromGraph(const Graph &g)
+{
+    br::HugeVector<uint64_t> keys(static_cast<size_t>(g.edges()));
+    parallelFor(0, static_cast<size_t>(g.vertices()), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (auto u = static_cast<int>(chunkStart); u < static_cast<int>(chunkEnd); ++u) {
+            auto first = static_cast<size_t>(g.edgeIndex(u));
+            auto row = g.neighbors(u);
+            for (size_t k = 0; k < row.size(); ++k) {
+                keys[first + k] = (static_cast<uint64_t>(u) << 32) | static_cast<uint32_t>(row[k]);
+            }
+        }
+    });
+    return EdgeStream(g.vertices(), keys);
+}
+
+int EdgeStream::vertices() const
+{
+    return vertexCount_;
+}
+
+int64_t EdgeStream::edges() const
+{
+    return static_cast<int64_t>(edges_.size());
+}
+
+int EdgeStream::partitions() const
+{
+    return static_cast<int>(partitionStarts_.size()) - 1;
+}
+
+BfsResult EdgeStream::bfs(int startVertex, const br::StopToken &stop) const
+{
+    BfsResult result{std::vector<int>(vertexCount_, -1)};
+    if (startVertex < 0 || startVertex >= vertexCount_)
+        return result;
+
+    const auto count = static_cast<size_t>(partitions());
+    const size_t chunks = threadCount();
+    // updates[c * count + q] - концы ребер в раздел q от куска c фазы scatter (кусков не больше threadCount()).
+    // Буферов threadCount() * count, а не по паре разделов: таблица растет линейно с числом вершин.
+    // Пишет только свой кусок scatter, читает и очищает только gather раздела q, фазы разделены parallelFor
+    std::vector<std::vector<int>> updates(chunks * count);
+    std::vector<uint8_t> active(count, 0);
+    result.distances[startVertex] = 0;
+    active[partitionOf(startVertex)] = 1;
+
+    for (int depth = 0;; ++depth) {
+        parallelFor(0, count, [&](size_t chunkStart, size_t chunkEnd, size_t chunk) {
+            auto *out = updates.data() + chunk * count;
+            for (size_t p = chunkStart; p < chunkEnd && !stop.StopRequested(); ++p) {
+                if (!active[p])
+                    continue;
+                for (size_t e = partitionStarts_[p]; e < partitionStarts_[p + 1]; ++e) {
+                    uint64_t key = edges_[e];
+                    if (result.distances[key >> 32] == depth) {
+                        auto dest = static_cast<int>(static_cast<uint32_t>(key));
+                        out[partitionOf(dest)].push_back(dest);
+                    }
+                }
+            }
+        });
+
+        bool grew = false;
+        parallelFor(0, count, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            for (size_t q = chunkStart; q < chunkEnd; ++q) {
+                active[q] = 0;
+                for (size_t c = 0; c < chunks; ++c) {
+                    auto &in = updates[c * count + q];
+                    for (int v : in) {
+                        if (result.distances[v] == -1) {
+                            result.distances[v] = depth + 1;
+                            active[q] = 1;
+                        }
+                    }
+                    in.clear();
+                }
+                if (active[q])
+                    std::atomic_ref<bool>(grew).store(true, std::memory_order_relaxed);
+            }
+        });
+        if (!grew || stop.StopRequested())
+            break;
+    }
+    result.status = traversalStatus(stop);
+    return result;
+}
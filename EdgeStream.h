@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Graph.h"
+
+constexpr int STREAM_PARTITION_VERTICES = 1 << 16; // расстояния раздела (256 КБ) помещаются в L2
+
+// Граф для реберно-центричного BFS в стиле X-Stream: неупорядоченный список ребер, разложенный по разделам
+// вершин источника. Уровень - два последовательных прохода без чтений строк вразнобой:
+//   scatter - каждый раздел с вершинами фронта читает свои ребра подряд и дописывает концы ребер
+//             из фронта в буфер раздела назначения;
+//   gather  - каждый раздел подряд читает адресованные ему буферы и отмечает новые вершины.
+// Случайны только обращения к расстояниям внутри одного раздела, а они помещаются в кэш.
+// Зато каждый уровень перечитывает все ребра активных разделов: на графах с тысячами уровней это дороже
+// обхода по строкам
+class EdgeStream {
+public:
+    // Ключи ребер src << 32 | dest в любом порядке, как их упаковывает RandomGraphGenerator
+    EdgeStream(int vertices, std::span<const uint64_t> edges);
+    static EdgeStream fromGraph(const Graph &g);
+
+    [[nodiscard]] int vertices() const;
+    [[nodiscard]] int64_t edges() const;
+    [[nodiscard]] int partitions() const;
+
+    // Разделы обрабатываются параллельно; раздел без вершин фронта не читается вовсе
+    [[nodiscard]] BfsResult bfs(int startVertex, const br::StopToken &stop = {}) const;
+
+private:
+    [[nodiscard]] static int partitionOf(int vertex)
+    {
+        return vertex / STREAM_PARTITION_VERTICES;
+    }
+
+    int vertexCount_;
+    br::HugeVector<uint64_t> edges_;      // сгруппированы по разделу источника
+    std::vector<size_t> partitionStarts_; // ребра раздела p - [partitionStarts_[p], partitionStarts_[p + 1])
+};
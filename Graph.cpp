@@ -1,108 +1,693 @@
 #include "Graph.h"
-#include "bedrock.h"
+#include "Parallel.h"
+#include "Traversal.h"
 
 #include <atomic>
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <future>
 #include <iostream>
-#include <queue>
-
-static unsigned int THREAD_COUNT = []() {
-    if (auto env = std::getenv("TP_SIZE")) {
-        auto result = std::atoi(env);
-        if (result > 0) {
-            std::cerr << "Using custom tp size: " << result << '\n';
-            return static_cast<unsigned int>(result);
-        }
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr char FILE_MAGIC[8] = {'B', 'R', 'G', 'R', 'A', 'P', 'H', '\0'};
+constexpr uint32_t FILE_VERSION = 1;
+constexpr uint32_t FLAG_SYMMETRIC = 1; // в старых файлах поле флагов было резервным нулем
+constexpr uint32_t FLAG_WEIGHTED = 2;  // после targets лежат int32 веса, по одному на ребро
+
+// Пороги переключения direction-optimizing BFS из статьи Beamer et al.
+constexpr int64_t BOTTOM_UP_ALPHA = 15; // вниз-вверх, когда ребер фронта больше 1/ALPHA непросмотренных
+constexpr int64_t BOTTOM_UP_BETA = 18;  // обратно, когда фронт меньше V / BETA и сужается
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int64_t vertexCount;
+    int64_t edgeCount;
+};
+static_assert(sizeof(FileHeader) == 32);
+
+// Владелец отображения: munmap при уничтожении последней копии графа
+struct Mapping {
+    void *data;
+    size_t size;
+
+    ~Mapping()
+    {
+        munmap(data, size);
     }
-    std::cerr << "Using default hardware concurency: " << std::thread::hardware_concurrency() << '\n';
-    return std::thread::hardware_concurrency();
-}();
+};
 
-static auto pool = []() { return br::ThreadPool(THREAD_COUNT); }();
+FileHeader fileHeader(const Graph &g)
+{
+    FileHeader header{};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.flags = (g.isSymmetric() ? FLAG_SYMMETRIC : 0) | (g.hasWeights() ? FLAG_WEIGHTED : 0);
+    header.vertexCount = g.vertices();
+    header.edgeCount = g.edges();
+    return header;
+}
 
-Graph::Graph(int vertices) : vertexCount_(vertices), matrix_(vertices) {}
+// Сигнатура, версия и размер: файл или сегмент ровно такой длины, какую обещает заголовок
+void checkHeader(const FileHeader &header, size_t size, const std::string &source)
+{
+    bool complete = std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire); // пара к release в publishShared
+    if (!complete || header.version != FILE_VERSION)
+        throw std::runtime_error(source + " has unknown format or version");
+    bool weighted = (header.flags & FLAG_WEIGHTED) != 0;
+    // Счетчики из заголовка сначала сверяем с размером, и только потом умножаем: иначе огромный
+    // edgeCount переполняет произведение и поддельный образ проходит проверку длины
+    const size_t payload = size - std::min(size, sizeof(FileHeader));
+    const size_t edgeBytes = sizeof(int) * (weighted ? 2 : 1);
+    bool fits = size >= sizeof(FileHeader) && header.vertexCount >= 0 &&
+                header.vertexCount <= std::numeric_limits<int>::max() && header.edgeCount >= 0 &&
+                static_cast<size_t>(header.vertexCount) + 1 <= payload / sizeof(int64_t);
+    if (fits) {
+        size_t offsetBytes = sizeof(int64_t) * (static_cast<size_t>(header.vertexCount) + 1);
+        fits = static_cast<uint64_t>(header.edgeCount) <= (payload - offsetBytes) / edgeBytes &&
+               payload == offsetBytes + edgeBytes * static_cast<size_t>(header.edgeCount);
+    }
+    if (!fits)
+        throw std::runtime_error(source + " is truncated or corrupted");
+}
+
+// Массивы образа из недоверенного источника: targets идут вместе с весами, если weighted
+void checkCsr(std::span<const int64_t> offsets, std::span<const int> arrays, int vertices, bool weighted,
+              const std::string &source)
+{
+    const auto edges = static_cast<int64_t>(weighted ? arrays.size() / 2 : arrays.size());
+    if (offsets.front() != 0 || offsets.back() != edges)
+        throw std::runtime_error(source + " has inconsistent offsets");
+    std::atomic<bool> corrupted = false;
+    parallelFor(0, static_cast<size_t>(vertices), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t v = chunkStart; v < chunkEnd && !corrupted.load(std::memory_order_relaxed); ++v) {
+            // Строку читаем, только убедившись, что ее границы внутри массива
+            if (offsets[v] > offsets[v + 1] || offsets[v + 1] > edges) {
+                corrupted = true;
+                break;
+            }
+            for (int64_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+                if (arrays[e] < 0 || arrays[e] >= vertices || (weighted && arrays[edges + e] < 0))
+                    corrupted = true;
+            }
+        }
+    });
+    if (corrupted)
+        throw std::runtime_error(source + " has corrupted offsets, targets or weights");
+}
+
+// shm_open ждет имя вида /name без других слешей
+std::string segmentName(const std::string &name)
+{
+    if (name.empty() || name.find('/', 1) != std::string::npos)
+        throw std::invalid_argument("Bad shared segment name: " + name);
+    return name.front() == '/' ? name : '/' + name;
+}
+} // namespace
+
+Graph::Graph(int vertices) : Graph(vertices, br::HugeVector<int64_t>(static_cast<size_t>(vertices) + 1, 0), {}) {}
+
+Graph::Graph(int vertices, br::HugeVector<int64_t> offsets, br::HugeVector<int> targets) : vertexCount_(vertices)
+{
+    if (offsets.size() != static_cast<size_t>(vertices) + 1 || offsets.back() != static_cast<int64_t>(targets.size()))
+        throw std::invalid_argument("CSR offsets do not match vertex or edge count");
+    auto csr = std::make_shared<Csr>(std::move(offsets), std::move(targets));
+    offsets_ = csr->offsets;
+    targets_ = csr->targets;
+    storage_ = std::move(csr);
+}
+
+Graph::Graph(int vertices, const std::vector<int64_t> &offsets, const std::vector<int> &targets)
+    : Graph(vertices, br::HugeVector<int64_t>(offsets.begin(), offsets.end()),
+            br::HugeVector<int>(targets.begin(), targets.end()))
+{
+}
+
+Graph Graph::fromSymmetricCsr(int vertices, br::HugeVector<int64_t> offsets, br::HugeVector<int> targets)
+{
+    Graph g(vertices, std::move(offsets), std::move(targets));
+    g.symmetric_ = true;
+    return g;
+}
+
+Graph::Graph(int vertices, std::span<const int64_t> offsets, std::span<const int> targets,
+             std::shared_ptr<const void> storage)
+    : vertexCount_(vertices), offsets_(offsets), targets_(targets), storage_(std::move(storage))
+{
+}
 
-void Graph::addEdge(int src, int dest)
+void Graph::addEdge(int src, int dest, int weight)
 {
     if (src < 0 || dest < 0 || src >= vertexCount_ || dest >= vertexCount_)
         return;
-    auto &&vec = matrix_[src];
-    if (std::find(vec.begin(), vec.end(), dest) == vec.end()) {
-        vec.push_back(dest);
+    auto row = neighbors(src);
+    if (std::find(row.begin(), row.end(), dest) != row.end())
+        return;
+
+    // Общие массивы не трогаем: копии графа и отображенный файл должны остаться как были
+    br::HugeVector<int64_t> offsets(offsets_.begin(), offsets_.end());
+    br::HugeVector<int> targets;
+    targets.reserve(targets_.size() + 1);
+    targets.insert(targets.end(), targets_.begin(), targets_.begin() + offsets_[src + 1]);
+    targets.push_back(dest);
+    targets.insert(targets.end(), targets_.begin() + offsets_[src + 1], targets_.end());
+    for (int v = src + 1; v <= vertexCount_; ++v) {
+        ++offsets[v];
+    }
+    std::vector<int> weights;
+    if (hasWeights()) {
+        weights.reserve(weights_.size() + 1);
+        weights.insert(weights.end(), weights_.begin(), weights_.begin() + offsets_[src + 1]);
+        weights.push_back(weight);
+        weights.insert(weights.end(), weights_.begin() + offsets_[src + 1], weights_.end());
+    }
+    bool rebuildInEdges = inStorage_ != nullptr;
+    bool symmetric = symmetric_;
+    bool weighted = hasWeights();
+    *this = Graph(vertexCount_, std::move(offsets), std::move(targets));
+    symmetric_ = symmetric;
+    if (weighted)
+        *this = withWeights(std::move(weights));
+    if (rebuildInEdges)
+        buildInEdges();
+    if (symmetric_)
+        addEdge(dest, src, weight); // обратное ребро уже есть - вызов сразу вернется
+}
+
+Graph Graph::withWeights(std::vector<int> weights) const
+{
+    if (weights.size() != targets_.size())
+        throw std::invalid_argument("Edge weights do not match edge count");
+    if (std::any_of(weights.begin(), weights.end(), [](int w) { return w < 0; }))
+        throw std::invalid_argument("Edge weights must be non-negative");
+    Graph g = *this;
+    auto storage = std::make_shared<std::vector<int>>(std::move(weights));
+    g.weights_ = *storage;
+    g.weightStorage_ = std::move(storage);
+    return g;
+}
+
+InEdgeStats Graph::buildInEdges()
+{
+    if (symmetric_)
+        return {};
+    auto start = std::chrono::steady_clock::now();
+    const int n = vertexCount_;
+    std::vector<std::atomic<int64_t>> degree(static_cast<size_t>(n) + 1);
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            for (int v : neighbors(static_cast<int>(u))) {
+                degree[v].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    auto in = std::make_shared<Csr>();
+    in->offsets.resize(static_cast<size_t>(n) + 1);
+    int64_t total = 0;
+    for (int v = 0; v < n; ++v) {
+        in->offsets[v] = total;
+        total += degree[v].load(std::memory_order_relaxed);
+        degree[v].store(in->offsets[v], std::memory_order_relaxed); // дальше это курсор записи
+    }
+    in->offsets[n] = total;
+    in->targets.resize(static_cast<size_t>(total));
+
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            for (int v : neighbors(static_cast<int>(u))) {
+                in->targets[degree[v].fetch_add(1, std::memory_order_relaxed)] = static_cast<int>(u);
+            }
+        }
+    });
+
+    inOffsets_ = in->offsets;
+    inTargets_ = in->targets;
+    InEdgeStats stats;
+    stats.bytes = static_cast<int64_t>(inOffsets_.size_bytes() + inTargets_.size_bytes());
+    inStorage_ = std::move(in);
+    stats.buildTime =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    return stats;
+}
+
+void Graph::save(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open " + path + " for writing");
+    FileHeader header = fileHeader(*this);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(offsets_.data()), static_cast<std::streamsize>(offsets_.size_bytes()));
+    out.write(reinterpret_cast<const char *>(targets_.data()), static_cast<std::streamsize>(targets_.size_bytes()));
+    if (hasWeights())
+        out.write(reinterpret_cast<const char *>(weights_.data()), static_cast<std::streamsize>(weights_.size_bytes()));
+    if (!out)
+        throw std::runtime_error("Failed to write " + path);
+}
+
+Graph Graph::load(const std::string &path, ImageCheck check)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    return mapImage(fd, path, check);
+}
+
+Graph::FileLayout Graph::fileLayout(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    struct stat st{};
+    FileHeader header{};
+    bool read = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header);
+    close(fd);
+    if (!read)
+        throw std::runtime_error(path + " is not a graph file");
+    checkHeader(header, static_cast<size_t>(st.st_size), path);
+    FileLayout layout;
+    layout.vertices = static_cast<int>(header.vertexCount);
+    layout.edges = header.edgeCount;
+    layout.symmetric = (header.flags & FLAG_SYMMETRIC) != 0;
+    layout.weighted = (header.flags & FLAG_WEIGHTED) != 0;
+    layout.offsetsPosition = sizeof(FileHeader);
+    layout.targetsPosition = layout.offsetsPosition + static_cast<int64_t>(sizeof(int64_t)) * (header.vertexCount + 1);
+    return layout;
+}
+
+void Graph::publishShared(const std::string &name) const
+{
+    auto segment = segmentName(name);
+    // Новый сегмент, а не перезапись старого: подключенные к старому процессы дочитывают свою копию
+    shm_unlink(segment.c_str());
+    int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Failed to create shared segment " + segment + ": " + std::strerror(errno));
+    size_t size = sizeof(FileHeader) + offsets_.size_bytes() + targets_.size_bytes() + weights_.size_bytes();
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(segment.c_str());
+        throw std::runtime_error("Failed to size shared segment " + segment + ": " + std::strerror(error));
+    }
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        shm_unlink(segment.c_str());
+        throw std::runtime_error("Failed to mmap shared segment " + segment + ": " + std::strerror(errno));
+    }
+    Mapping mapping{data, size};
+
+    auto *header = static_cast<FileHeader *>(data);
+    auto *out = reinterpret_cast<char *>(header + 1);
+    out = std::copy_n(reinterpret_cast<const char *>(offsets_.data()), offsets_.size_bytes(), out);
+    out = std::copy_n(reinterpret_cast<const char *>(targets_.data()), targets_.size_bytes(), out);
+    std::copy_n(reinterpret_cast<const char *>(weights_.data()), weights_.size_bytes(), out);
+    // Сигнатура появляется последней: процесс, подключившийся посреди записи, увидит нули и получит ошибку,
+    // а не половину графа
+    FileHeader pending = fileHeader(*this);
+    std::memset(pending.magic, 0, sizeof(pending.magic));
+    *header = pending;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+}
+
+Graph Graph::attachShared(const std::string &name, ImageCheck check)
+{
+    auto segment = segmentName(name);
+    int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open shared segment " + segment + ": " + std::strerror(errno));
+    return mapImage(fd, segment, check);
+}
+
+void Graph::unlinkShared(const std::string &name)
+{
+    auto segment = segmentName(name);
+    if (shm_unlink(segment.c_str()) != 0 && errno != ENOENT)
+        throw std::runtime_error("Failed to unlink shared segment " + segment + ": " + std::strerror(errno));
+}
+
+Graph Graph::mapImage(int fd, const std::string &source, ImageCheck check)
+{
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        close(fd);
+        throw std::runtime_error(source + " is not a graph file");
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Failed to mmap " + source + ": " + std::strerror(errno));
+    auto mapping = std::make_shared<Mapping>(data, size);
+
+    const auto *header = static_cast<const FileHeader *>(data);
+    checkHeader(*header, size, source);
+    bool weighted = (header->flags & FLAG_WEIGHTED) != 0;
+
+    auto vertices = static_cast<int>(header->vertexCount);
+    const auto *offsets = reinterpret_cast<const int64_t *>(header + 1);
+    const auto *targets = reinterpret_cast<const int *>(offsets + vertices + 1);
+    if (check == ImageCheck::VERIFY)
+        checkCsr(std::span(offsets, static_cast<size_t>(vertices) + 1),
+                 std::span(targets, static_cast<size_t>(header->edgeCount) * (weighted ? 2 : 1)), vertices, weighted,
+                 source);
+    Graph g(vertices, std::span(offsets, static_cast<size_t>(vertices) + 1),
+            std::span(targets, static_cast<size_t>(header->edgeCount)), std::move(mapping));
+    g.symmetric_ = (header->flags & FLAG_SYMMETRIC) != 0;
+    if (weighted) {
+        g.weights_ = std::span(targets + header->edgeCount, static_cast<size_t>(header->edgeCount));
+        g.weightStorage_ = g.storage_;
     }
+    return g;
+}
+
+TraversalStatus Graph::parallelBFS(int startVertex, const br::StopToken &stop) const
+{
+    return parallelTraverseBFS(*this, startVertex, NoVisitor{}, stop);
 }
 
-struct alignas(64) AlignedBool {
-    std::atomic<bool> flag;
+namespace {
+struct Relaxation {
+    int vertex;
+    int distance;
 };
 
-void Graph::parallelBFS(int startVertex) const
+struct alignas(64) StealQueue {
+    br::Mutex<std::deque<Relaxation>> items;
+};
+
+constexpr size_t ASYNC_BATCH = 64;
+} // namespace
+
+BfsResult Graph::asyncBFS(int startVertex, const br::StopToken &stop) const
 {
     if (startVertex < 0 || startVertex >= vertexCount_)
-        return;
+        return {};
 
-    std::vector<AlignedBool> visited(vertexCount_);
+    constexpr int unreached = std::numeric_limits<int>::max();
+    std::vector<std::atomic<int>> dist(vertexCount_);
     for (int i = 0; i < vertexCount_; ++i) {
-        visited[i].flag.store(false, std::memory_order_relaxed);
+        dist[i].store(unreached, std::memory_order_relaxed);
     }
+    dist[startVertex].store(0, std::memory_order_relaxed);
 
-    std::vector<int> currentLevel;
-    currentLevel.push_back(startVertex);
-    visited[startVertex].flag.store(true, std::memory_order_relaxed);
+    const unsigned int workers = threadCount();
+    std::vector<StealQueue> queues(workers);
+    queues[0].items.Lock()->push_back({startVertex, 0});
+    // Число записей, которые уже опубликованы, но еще не обработаны. Новые записи учитываются
+    // до того, как снимается родительская, поэтому ноль означает, что работы больше нет
+    std::atomic<int64_t> pending{1};
 
-    while (!currentLevel.empty()) {
-        br::Mutex<std::vector<int>> nextLevel;
-        size_t chunkSize = (currentLevel.size() + THREAD_COUNT - 1) / THREAD_COUNT;
-        br::WaitGroup wg(1 + ((currentLevel.size() - 1) / chunkSize));
-        for (size_t chunkStart = 0; chunkStart < currentLevel.size(); chunkStart += chunkSize) {
-            size_t chunkEnd = std::min(chunkStart + chunkSize, currentLevel.size());
-            pool.Push([&, chunkStart, chunkEnd] mutable {
-                std::vector<int> localNextLevel;
-                for (size_t i = chunkStart; i < chunkEnd; ++i) {
-                    int u = currentLevel[i];
-                    for (int v : matrix_[u]) {
-                        bool expected = false;
-                        if (visited[v].flag.compare_exchange_strong(expected, true, std::memory_order_relaxed)) {
-                            localNextLevel.push_back(v);
-                        }
+    br::WaitGroup wg(workers);
+    for (unsigned int w = 0; w < workers; ++w) {
+        threadPool().Push([&, w] mutable {
+            auto &own = queues[w].items;
+            std::vector<Relaxation> batch;
+            std::vector<Relaxation> produced;
+            auto flush = [&] {
+                if (produced.empty())
+                    return;
+                pending.fetch_add(static_cast<int64_t>(produced.size()), std::memory_order_relaxed);
+                auto q = own.Lock();
+                q->insert(q->end(), produced.begin(), produced.end());
+                produced.clear();
+            };
+
+            while (!stop.StopRequested()) {
+                batch.clear();
+                {
+                    auto q = own.Lock();
+                    size_t take = std::min(q->size(), ASYNC_BATCH);
+                    batch.assign(q->begin(), q->begin() + static_cast<std::ptrdiff_t>(take));
+                    q->erase(q->begin(), q->begin() + static_cast<std::ptrdiff_t>(take));
+                }
+                if (batch.empty()) {
+                    // Своя очередь пуста: забираем половину чужой, начиная с самых близких вершин
+                    std::vector<Relaxation> stolen;
+                    for (unsigned int k = 1; k < workers && stolen.empty(); ++k) {
+                        auto victim = queues[(w + k) % workers].items.Lock();
+                        size_t take = (victim->size() + 1) / 2;
+                        stolen.assign(victim->begin(), victim->begin() + static_cast<std::ptrdiff_t>(take));
+                        victim->erase(victim->begin(), victim->begin() + static_cast<std::ptrdiff_t>(take));
+                    }
+                    if (stolen.empty()) {
+                        if (pending.load(std::memory_order_acquire) == 0)
+                            break;
+                        std::this_thread::yield();
+                        continue;
                     }
+                    auto q = own.Lock();
+                    q->insert(q->end(), stolen.begin(), stolen.end());
+                    continue;
                 }
-                if (!localNextLevel.empty()) {
-                    auto nL = nextLevel.Lock();
-                    nL->insert(nL->end(), localNextLevel.begin(), localNextLevel.end());
+
+                for (auto [u, d] : batch) {
+                    if (dist[u].load(std::memory_order_relaxed) < d)
+                        continue; // вершину уже улучшили, запись устарела
+                    for (int v : neighbors(u)) {
+                        int current = dist[v].load(std::memory_order_relaxed);
+                        while (d + 1 < current) {
+                            if (dist[v].compare_exchange_weak(current, d + 1, std::memory_order_relaxed)) {
+                                produced.push_back({v, d + 1});
+                                break;
+                            }
+                        }
+                    }
+                    if (produced.size() >= ASYNC_BATCH)
+                        flush();
                 }
-                wg.Done();
-            });
+                flush();
+                pending.fetch_sub(static_cast<int64_t>(batch.size()), std::memory_order_acq_rel);
+            }
+            wg.Done();
+        });
+    }
+    wg.Wait();
+
+    auto status = pending.load(std::memory_order_relaxed) == 0 ? TraversalStatus::COMPLETED : traversalStatus(stop);
+    BfsResult result{std::vector<int>(vertexCount_), status};
+    for (int i = 0; i < vertexCount_; ++i) {
+        int d = dist[i].load(std::memory_order_relaxed);
+        result.distances[i] = d == unreached ? -1 : d;
+    }
+    return result;
+}
+
+br::Generator<std::span<const int>> Graph::bfsLevels(int startVertex) const
+{
+    if (startVertex < 0 || startVertex >= vertexCount_)
+        co_return;
+
+    br::HugeVector<uint8_t> visited(vertexCount_ + VISITED_PADDING, 0);
+    visited[startVertex] = 1;
+    br::HugeVector<int> currentLevel{startVertex};
+    while (!currentLevel.empty()) {
+        co_yield std::span<const int>(currentLevel);
+        currentLevel = expandFrontier(
+            currentLevel, [&](int u) { return candidateNeighbors<NoVisitor>(*this, u, visited.data()); },
+            [&](int, int v) {
+                uint8_t expected = 0;
+                return std::atomic_ref<uint8_t>(visited[v]).compare_exchange_strong(expected, 1,
+                                                                                    std::memory_order_relaxed);
+            },
+            {}, QueuePrefetcher(*this, visited.data()));
+    }
+}
+
+BfsTree Graph::bfsTree(int startVertex, ParentClaim claim, const br::StopToken &stop) const
+{
+    BfsTree tree{std::vector<int>(vertexCount_, -1), TraversalStatus::COMPLETED};
+    if (startVertex < 0 || startVertex >= vertexCount_)
+        return tree;
+
+    auto &parent = tree.parent;
+    auto parentOf = [&](int v) { return std::atomic_ref<int>(parent[v]); };
+    parent[startVertex] = startVertex;
+    QueuePrefetcher prefetch(*this, parent.data());
+    br::HugeVector<int> currentLevel{startVertex};
+    while (!currentLevel.empty() && !stop.StopRequested()) {
+        if (claim == ParentClaim::CAS) {
+            currentLevel = expandFrontier(
+                currentLevel, [this](int u) { return neighbors(u); },
+                [&](int u, int v) {
+                    // Сначала дешевое чтение: большинство ребер ведут в уже захваченные вершины
+                    int expected = -1;
+                    return parentOf(v).load(std::memory_order_relaxed) == -1 &&
+                           parentOf(v).compare_exchange_strong(expected, u, std::memory_order_relaxed);
+                },
+                stop, prefetch);
+            continue;
         }
-        wg.Wait();
+
+        // Несколько потоков могут записать родителя одной вершины, тогда она попадет в пары
+        // несколько раз; после барьера значение parent[v] окончательное, и пара (u, v) уникальна
+        br::Mutex<std::vector<std::pair<int, int>>> discovered;
+        std::span<const int> level(currentLevel);
+        parallelFor(0, level.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            std::vector<std::pair<int, int>> local;
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                if ((i - chunkStart) % STOP_POLL_INTERVAL == 0 && stop.StopRequested())
+                    break;
+                prefetch(level.first(chunkEnd), i);
+                int u = level[i];
+                for (int v : neighbors(u)) {
+                    if (parentOf(v).load(std::memory_order_relaxed) == -1) {
+                        parentOf(v).store(u, std::memory_order_relaxed);
+                        local.emplace_back(u, v);
+                    }
+                }
+            }
+            auto d = discovered.Lock();
+            d->insert(d->end(), local.begin(), local.end());
+        });
+
+        auto pairs = std::move(*discovered.Lock());
+        br::Mutex<br::HugeVector<int>> nextLevel;
+        parallelFor(0, pairs.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            std::vector<int> local;
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                auto [u, v] = pairs[i];
+                if (parent[v] == u)
+                    local.push_back(v);
+            }
+            auto next = nextLevel.Lock();
+            next->insert(next->end(), local.begin(), local.end());
+        });
         currentLevel = std::move(*nextLevel.Lock());
     }
+    tree.status = traversalStatus(stop);
+    return tree;
 }
 
-void Graph::bfs(int startVertex) const
+BfsResult Graph::directionOptimizingBFS(int startVertex, const br::StopToken &stop) const
 {
+    if (!hasInEdges())
+        throw std::logic_error("Bottom-up BFS needs in-edges: build them or use an undirected graph");
+    BfsResult result{std::vector<int>(vertexCount_, -1), TraversalStatus::COMPLETED};
     if (startVertex < 0 || startVertex >= vertexCount_)
-        return;
-    std::vector<char> visited(vertexCount_, 0);
-    std::queue<int> q;
+        return result;
 
-    visited[startVertex] = 1;
-    q.push(startVertex);
-
-    while (!q.empty()) {
-        int u = q.front();
-        q.pop();
-        for (int n : matrix_[u]) {
-            if (!visited[n]) {
-                visited[n] = 1;
-                q.push(n);
+    auto &dist = result.distances;
+    auto distOf = [&](int v) { return std::atomic_ref<int>(dist[v]); };
+    auto degreeSum = [&](const br::HugeVector<int> &level) {
+        std::atomic<int64_t> sum = 0;
+        parallelFor(0, level.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            int64_t local = 0;
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                local += static_cast<int64_t>(neighbors(level[i]).size());
             }
+            sum.fetch_add(local, std::memory_order_relaxed);
+        });
+        return sum.load(std::memory_order_relaxed);
+    };
+
+    dist[startVertex] = 0;
+    br::HugeVector<int> frontier{startVertex};
+    int64_t frontierEdges = static_cast<int64_t>(neighbors(startVertex).size());
+    int64_t uncheckedEdges = edges() - frontierEdges;
+    // Во время bottom-up фронт живет байтовой картой: ее читают все потоки при поиске родителя
+    br::HugeVector<uint8_t> inFrontier;
+    br::HugeVector<uint8_t> inNext;
+    for (int depth = 0; !frontier.empty() && !stop.StopRequested(); ++depth) {
+        if (frontierEdges <= uncheckedEdges / BOTTOM_UP_ALPHA) {
+            frontier = expandFrontier(
+                frontier, [this](int u) { return neighbors(u); },
+                [&](int, int v) {
+                    int expected = -1;
+                    return distOf(v).load(std::memory_order_relaxed) == -1 &&
+                           distOf(v).compare_exchange_strong(expected, depth + 1, std::memory_order_relaxed);
+                },
+                stop);
+            frontierEdges = degreeSum(frontier);
+            uncheckedEdges -= frontierEdges;
+            continue;
+        }
+
+        inFrontier.assign(vertexCount_, 0);
+        inNext.assign(vertexCount_, 0);
+        for (int v : frontier) {
+            inFrontier[v] = 1;
         }
+        int64_t awake = static_cast<int64_t>(frontier.size());
+        int64_t previous = 0;
+        // Остаемся внизу, пока фронт растет или еще велик: каждый шаг просматривает все непосещенные вершины
+        for (; awake > 0 && (awake >= previous || awake > vertexCount_ / BOTTOM_UP_BETA) && !stop.StopRequested();
+             ++depth) {
+            std::atomic<int64_t> found = 0;
+            parallelFor(0, vertexCount_, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+                int64_t local = 0;
+                for (size_t v = chunkStart; v < chunkEnd; ++v) {
+                    if ((v - chunkStart) % (STOP_POLL_INTERVAL * 64) == 0 && stop.StopRequested())
+                        break;
+                    if (dist[v] != -1)
+                        continue;
+                    for (int w : inNeighbors(static_cast<int>(v))) {
+                        if (inFrontier[w]) {
+                            dist[v] = depth + 1;
+                            inNext[v] = 1;
+                            ++local;
+                            break;
+                        }
+                    }
+                }
+                found.fetch_add(local, std::memory_order_relaxed);
+            });
+            previous = awake;
+            awake = found.load(std::memory_order_relaxed);
+            std::swap(inFrontier, inNext);
+            std::fill(inNext.begin(), inNext.end(), 0);
+        }
+        // Цикл уровней тоже увеличит depth, а текущий фронт - вершины на глубине depth
+        --depth;
+
+        frontier.clear();
+        for (int v = 0; v < vertexCount_; ++v) {
+            if (inFrontier[v])
+                frontier.push_back(v);
+        }
+        frontierEdges = degreeSum(frontier);
+        std::atomic<int64_t> unchecked = 0;
+        parallelFor(0, vertexCount_, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+            int64_t local = 0;
+            for (size_t v = chunkStart; v < chunkEnd; ++v) {
+                if (dist[v] == -1)
+                    local += static_cast<int64_t>(neighbors(static_cast<int>(v)).size());
+            }
+            unchecked.fetch_add(local, std::memory_order_relaxed);
+        });
+        uncheckedEdges = unchecked.load(std::memory_order_relaxed);
     }
+    result.status = traversalStatus(stop);
+    return result;
+}
+
+TraversalStatus Graph::bfs(int startVertex, const br::StopToken &stop) const
+{
+    return traverseBFS(*this, startVertex, NoVisitor{}, stop);
 }
 
 int Graph::vertices() const
 {
     return vertexCount_;
+}
+
+int64_t Graph::edges() const
+{
+    return static_cast<int64_t>(targets_.size());
 }
\ No newline at end of file
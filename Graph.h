@@ -1,15 +1,187 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
+#include "bedrock.h"
 
+enum class TraversalStatus : uint8_t { COMPLETED = 0, CANCELLED, DEADLINE_EXCEEDED };
+
+inline TraversalStatus traversalStatus(const br::StopToken &stop)
+{
+    switch (stop.Reason()) {
+        case br::StopReason::NONE:
+            return TraversalStatus::COMPLETED;
+        case br::StopReason::CANCELLED:
+            return TraversalStatus::CANCELLED;
+        case br::StopReason::DEADLINE:
+            return TraversalStatus::DEADLINE_EXCEEDED;
+    }
+    return TraversalStatus::COMPLETED;
+}
+
+// Расстояния от стартовой вершины, -1 для недостижимых. Если обход остановлен по токену,
+// status это показывает, а расстояния - лишь верхние оценки для уже найденных вершин
+struct BfsResult {
+    std::vector<int> distances;
+    TraversalStatus status = TraversalStatus::COMPLETED;
+};
+
+// Как захватывать вершину, когда сам массив родителей служит visited (в стиле Graph500)
+//   CAS         - compare-exchange parent[v] с -1 на u, каждая вершина попадает во фронт ровно раз
+//   BENIGN_RACE - обычная запись без CAS, побеждает последний писатель; фронт собирается из пар (u, v)
+//                 и после барьера в нем остаются только пары с parent[v] == u
+enum class ParentClaim : uint8_t { CAS = 0, BENIGN_RACE };
+
+// Дерево BFS: parent[v] - вершина, из которой v достигнута, -1 для недостижимых,
+// у стартовой вершины родитель она сама
+struct BfsTree {
+    std::vector<int> parent;
+    TraversalStatus status = TraversalStatus::COMPLETED;
+};
+
+// Во что обошлись входящие ребра: сколько памяти заняли и сколько строились
+struct InEdgeStats {
+    int64_t bytes = 0;
+    std::chrono::milliseconds buildTime{0};
+};
+
+// Граф хранится в CSR: offsets_[v]..offsets_[v + 1] - диапазон соседей v в targets_.
+// Массивы неизменяемы и разделяются между копиями, память принадлежит storage_
+// (собственные векторы или отображенный в память файл). Обратный CSR строится только по запросу.
+// Неориентированный граф хранится симметричным: каждое ребро в обе стороны, входящие ребра = исходящие
 class Graph {
 public:
     explicit Graph(int vertices);
-    void addEdge(int src, int dest);
-    void parallelBFS(int startVertex) const; // заглушка, как в Java
-    void bfs(int startVertex) const;         // обычный BFS
+    // offsets размером vertices + 1, соседи каждой вершины без повторов. Массивы на huge pages (br::HugeVector):
+    // строки и смещения читаются вразнобой, и на 4 КБ страницах обход упирается в промахи dTLB
+    Graph(int vertices, br::HugeVector<int64_t> offsets, br::HugeVector<int> targets);
+    // Обычные векторы копируются в br::HugeVector
+    Graph(int vertices, const std::vector<int64_t> &offsets, const std::vector<int> &targets);
+    // То же для неориентированного графа: v есть в строке u тогда и только тогда, когда u есть в строке v.
+    // Симметричность не проверяется
+    static Graph fromSymmetricCsr(int vertices, br::HugeVector<int64_t> offsets, br::HugeVector<int> targets);
+    // Перестраивает CSR целиком, O(V + E): для точечных правок, массово граф строится из CSR.
+    // В неориентированном графе добавляет ребро в обе стороны, weight учитывается только во взвешенном
+    void addEdge(int src, int dest, int weight = 1);
+    // Копия с весами ребер: weights[i] - вес ребра targets[i], отдельный массив рядом с targets (SoA).
+    // Веса неотрицательны, у неориентированного графа вес u -> v должен совпадать с весом v -> u
+    [[nodiscard]] Graph withWeights(std::vector<int> weights) const;
+    // Движки опрашивают stop раз в кусок работы и при остановке возвращают ее причину
+    TraversalStatus parallelBFS(int startVertex, const br::StopToken &stop = {}) const; // заглушка, как в Java
+    TraversalStatus bfs(int startVertex, const br::StopToken &stop = {}) const;         // обычный BFS
+    // Асинхронный BFS без барьера на каждом уровне: расстояния уточняются через atomic-min,
+    // работа распределяется между потоками кражей
+    [[nodiscard]] BfsResult asyncBFS(int startVertex, const br::StopToken &stop = {}) const;
+    // Уровни BFS по одному: следующий уровень считается параллельно, только когда потребитель
+    // продвигает итератор, так что остановка после первых N вершин не стоит обхода всего графа.
+    // span действителен до следующего шага, граф должен пережить генератор
+    br::Generator<std::span<const int>> bfsLevels(int startVertex) const;
+    // Параллельное дерево BFS без отдельного visited: одна случайная запись на вершину вместо двух
+    [[nodiscard]] BfsTree bfsTree(int startVertex, ParentClaim claim = ParentClaim::CAS,
+                                  const br::StopToken &stop = {}) const;
+    // Direction-optimizing BFS (Beamer): на широких уровнях переходит на bottom-up, где непосещенная
+    // вершина ищет родителя среди входящих соседей и останавливается на первом. Нужны входящие ребра:
+    // у неориентированного графа они есть даром, иначе - после buildInEdges, без них std::logic_error
+    [[nodiscard]] BfsResult directionOptimizingBFS(int startVertex, const br::StopToken &stop = {}) const;
     [[nodiscard]] int vertices() const;
+    [[nodiscard]] int64_t edges() const; // в неориентированном графе каждое ребро считается дважды
+    [[nodiscard]] bool isSymmetric() const
+    {
+        return symmetric_;
+    }
+    [[nodiscard]] bool hasWeights() const
+    {
+        return weightStorage_ != nullptr;
+    }
+    // Номер первого ребра vertex в массивах targets и weights
+    [[nodiscard]] int64_t edgeIndex(int vertex) const
+    {
+        return offsets_[vertex];
+    }
+    // Веса ребер строки vertex в том же порядке, что и neighbors(vertex). Только если hasWeights()
+    [[nodiscard]] std::span<const int> edgeWeights(int vertex) const
+    {
+        return weights_.subspan(offsets_[vertex], offsets_[vertex + 1] - offsets_[vertex]);
+    }
+    [[nodiscard]] std::span<const int> neighbors(int vertex) const
+    {
+        return targets_.subspan(offsets_[vertex], offsets_[vertex + 1] - offsets_[vertex]);
+    }
+    // Транспонирует граф параллельной сортировкой подсчетом: еще V + 1 смещений и E вершин.
+    // Порядок вершин внутри строки входящих ребер не определен. addEdge перестраивает их заново.
+    // Неориентированному графу транспонирование не нужно, он ничего не строит
+    InEdgeStats buildInEdges();
+    [[nodiscard]] bool hasInEdges() const
+    {
+        return symmetric_ || inStorage_ != nullptr;
+    }
+    // Только если hasInEdges()
+    [[nodiscard]] std::span<const int> inNeighbors(int vertex) const
+    {
+        if (symmetric_)
+            return neighbors(vertex);
+        return inTargets_.subspan(inOffsets_[vertex], inOffsets_[vertex + 1] - inOffsets_[vertex]);
+    }
+    // Подсказки для конвейеров предвыборки в обходах: строка смещений и начало строки соседей
+    void prefetchOffsets(int vertex) const
+    {
+        __builtin_prefetch(offsets_.data() + vertex);
+    }
+    void prefetchNeighbors(int vertex) const
+    {
+        __builtin_prefetch(targets_.data() + offsets_[vertex]);
+    }
+
+    // Насколько доверять отображаемому образу. VERIFY проверяет за один параллельный проход O(V + E), что
+    // offsets[0] == 0, смещения не убывают и заканчиваются на числе ребер, соседи лежат в [0, V), а веса
+    // неотрицательны: иначе испорченный или чужой файл уводит любой обход за пределы массивов.
+    // TRUSTED - только заголовок и размер, для образов, которые записал этот же код
+    enum class ImageCheck : uint8_t { VERIFY = 0, TRUSTED };
+
+    // Бинарный файл: заголовок, offsets, targets и, если есть, weights. load отображает файл через mmap
+    void save(const std::string &path) const;
+    static Graph load(const std::string &path, ImageCheck check = ImageCheck::VERIFY);
+    // Где в файле save лежат массивы: для движков, которые читают файл сами, а не через load
+    struct FileLayout {
+        int vertices = 0;
+        int64_t edges = 0;
+        bool symmetric = false;
+        bool weighted = false;
+        int64_t offsetsPosition = 0; // vertices + 1 значений int64
+        int64_t targetsPosition = 0; // edges значений int32
+    };
+    static FileLayout fileLayout(const std::string &path);
+    // Тот же образ в именованном сегменте POSIX shared memory (/dev/shm), чтобы несколько процессов
+    // обходили одну копию графа. publishShared заменяет сегмент с этим именем: уже подключенные процессы
+    // дочитывают старый. attachShared отображает сегмент только для чтения и проверяет его, как load;
+    // с TRUSTED подключение стоит O(1). Сегмент живет, пока его не удалит unlinkShared, даже когда все
+    // процессы вышли
+    void publishShared(const std::string &name) const;
+    static Graph attachShared(const std::string &name, ImageCheck check = ImageCheck::VERIFY);
+    static void unlinkShared(const std::string &name);
 
 private:
+    struct Csr {
+        br::HugeVector<int64_t> offsets;
+        br::HugeVector<int> targets;
+    };
+
+    Graph(int vertices, std::span<const int64_t> offsets, std::span<const int> targets,
+          std::shared_ptr<const void> storage);
+    // Отображает образ из открытого fd (файл или сегмент) и закрывает fd, source - для сообщений об ошибках
+    static Graph mapImage(int fd, const std::string &source, ImageCheck check);
+
     int vertexCount_;
-    std::vector<std::vector<int>> matrix_;
+    std::span<const int64_t> offsets_;
+    std::span<const int> targets_;
+    std::shared_ptr<const void> storage_;
+    std::span<const int64_t> inOffsets_;
+    std::span<const int> inTargets_;
+    std::shared_ptr<const void> inStorage_;
+    std::span<const int> weights_;
+    std::shared_ptr<const void> weightStorage_;
+    bool symmetric_ = false;
 };
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "GraphBuilder.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <stdexcept>
+
+namespace {
+std::atomic<uint64_t> nextBuilderId{1};
+
+// Последний сборщик, в который писал поток, и его буфер в нем
+struct BufferCache {
+    uint64_t builder = 0;
+    void *buffer = nullptr;
+};
+thread_local BufferCache bufferCache;
+} // namespace
+
+GraphBuilder::GraphBuilder(int vertices)
+    : vertexCount_(vertices), id_(nextBuilderId.fetch_add(1, std::memory_order_relaxed)),
+      degree_(static_cast<size_t>(std::max(vertices, 0)))
+{
+    if (vertices < 0)
+        throw std::invalid_argument("Vertex count must be non-negative");
+}
+
+void GraphBuilder::addEdge(int src, int dest)
+{
+    if (src < 0 || dest < 0 || src >= vertexCount_ || dest >= vertexCount_)
+        throw std::out_of_range("Edge endpoint is out of graph");
+    localBuffer().edges.push_back(static_cast<uint64_t>(src) << 32 | static_cast<uint32_t>(dest));
+    degree_[src].fetch_add(1, std::memory_order_relaxed);
+}
+
+GraphBuilder::Buffer &GraphBuilder::localBuffer()
+{
+    if (bufferCache.builder == id_)
+        return *static_cast<Buffer *>(bufferCache.buffer);
+    auto buffers = buffers_.Lock();
+    auto self = std::this_thread::get_id();
+    auto it = std::find_if(buffers->begin(), buffers->end(), [&](const auto &b) { return b->owner == self; });
+    if (it == buffers->end()) {
+        buffers->push_back(std::make_unique<Buffer>());
+        buffers->back()->owner = self;
+        it = std::prev(buffers->end());
+    }
+    bufferCache = {id_, it->get()};
+    return **it;
+}
+
+Graph GraphBuilder::build(int64_t maxEdges) const
+{
+    const int n = vertexCount_;
+    // Смещения по степеням с повторами, посчитанным при вставке
+    std::vector<int64_t> rawOffsets(static_cast<size_t>(n) + 1, 0);
+    for (int v = 0; v < n; ++v) {
+        rawOffsets[v + 1] = rawOffsets[v] + degree_[v].load(std::memory_order_relaxed);
+    }
+    // Раскладка в два прохода, оба без атомиков. Сначала ребра расходятся по корзинам из смежных диапазонов
+    // вершин: у каждого куска буфера свой отрезок в каждой корзине, запись - в ~BUCKETS потоков подряд.
+    // Затем корзина, строки которой помещаются в кэш, раскладывается по строкам одной задачей
+    const int shift = std::max(0, static_cast<int>(std::bit_width(static_cast<unsigned>(std::max(n - 1, 0)))) -
+                                      std::countr_zero(BUCKETS));
+    const size_t buckets = (static_cast<size_t>(std::max(n - 1, 0)) >> shift) + 1;
+    auto buffers = buffers_.Lock();
+    std::vector<std::span<const uint64_t>> slices;
+    for (const auto &buffer : *buffers) {
+        std::span<const uint64_t> edges(buffer->edges);
+        for (size_t start = 0; start < edges.size(); start += SLICE_EDGES) {
+            slices.push_back(edges.subspan(start, std::min(SLICE_EDGES, edges.size() - start)));
+        }
+    }
+    // position[slice * buckets + bucket] - куда кусок пишет свои ребра этой корзины
+    std::vector<int64_t> position(slices.size() * buckets, 0);
+    parallelFor(0, slices.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t slice = chunkStart; slice < chunkEnd; ++slice) {
+            int64_t *count = position.data() + slice * buckets;
+            for (uint64_t edge : slices[slice]) {
+                ++count[(edge >> 32) >> shift];
+            }
+        }
+    });
+    std::vector<int64_t> bucketStart(buckets + 1, 0);
+    int64_t total = 0;
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        bucketStart[bucket] = total;
+        for (size_t slice = 0; slice < slices.size(); ++slice) {
+            int64_t count = position[slice * buckets + bucket];
+            position[slice * buckets + bucket] = total;
+            total += count;
+        }
+    }
+    bucketStart[buckets] = total;
+
+    br::HugeVector<uint64_t> staged(static_cast<size_t>(total));
+    parallelFor(0, slices.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t slice = chunkStart; slice < chunkEnd; ++slice) {
+            int64_t *cursor = position.data() + slice * buckets;
+            for (uint64_t edge : slices[slice]) {
+                staged[cursor[(edge >> 32) >> shift]++] = edge;
+            }
+        }
+    });
+
+    br::HugeVector<int> raw(static_cast<size_t>(rawOffsets[n]));
+    parallelFor(0, buckets, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        std::vector<int64_t> cursor;
+        for (size_t bucket = chunkStart; bucket < chunkEnd; ++bucket) {
+            const size_t first = bucket << shift;
+            const size_t last = std::min(static_cast<size_t>(n), (bucket + 1) << shift);
+            cursor.assign(rawOffsets.begin() + static_cast<std::ptrdiff_t>(first),
+                          rawOffsets.begin() + static_cast<std::ptrdiff_t>(last));
+            for (int64_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+                auto src = static_cast<size_t>(staged[i] >> 32);
+                raw[cursor[src - first]++] = static_cast<int>(staged[i] & 0xFFFFFFFFu);
+            }
+        }
+    });
+    staged = {};
+
+    // Строки сортируются на месте, уникальная часть остается в начале строки
+    br::HugeVector<int64_t> offsets(static_cast<size_t>(n) + 1, 0);
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t v = chunkStart; v < chunkEnd; ++v) {
+            auto first = raw.begin() + rawOffsets[v];
+            auto last = raw.begin() + rawOffsets[v + 1];
+            std::sort(first, last);
+            offsets[v + 1] = std::unique(first, last) - first;
+        }
+    });
+    for (int v = 0; v < n; ++v) {
+        offsets[v + 1] = std::min(offsets[v] + offsets[v + 1], maxEdges);
+    }
+
+    br::HugeVector<int> targets(static_cast<size_t>(offsets[n]));
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t v = chunkStart; v < chunkEnd; ++v) {
+            std::copy_n(raw.begin() + rawOffsets[v], offsets[v + 1] - offsets[v], targets.begin() + offsets[v]);
+        }
+    });
+    return Graph(n, std::move(offsets), std::move(targets));
+}
+
+int64_t GraphBuilder::addedEdges() const
+{
+    int64_t total = 0;
+    for (const auto &degree : degree_) {
+        total += degree.load(std::memory_order_relaxed);
+    }
+    return total;
+}
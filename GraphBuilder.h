@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Graph.h"
+#include "bedrock.h"
+
+// Сборка CSR из ребер, которые добавляют сразу много потоков. Каждый поток пишет в собственный буфер
+// (находит его через thread_local, блокировка - только при первой вставке потока), степени вершин
+// считаются атомарно прямо при вставке. build раскладывает буферы по строкам параллельной сортировкой
+// подсчетом в два прохода (по диапазонам вершин, затем по строкам), сортирует строки и убирает кратные ребра
+class GraphBuilder {
+public:
+    explicit GraphBuilder(int vertices);
+    GraphBuilder(const GraphBuilder &) = delete;
+    GraphBuilder &operator=(const GraphBuilder &) = delete;
+
+    // Потокобезопасно, без блокировок. Вершины вне графа - std::out_of_range
+    void addEdge(int src, int dest);
+    // Граф из всех добавленных ребер: соседи в строках по возрастанию, без повторов. Если ребер больше
+    // maxEdges, остаются первые maxEdges в порядке (src, dest). Буферы не очищаются, так что после новых
+    // addEdge можно собрать снова. Нельзя звать одновременно с addEdge
+    [[nodiscard]] Graph build(int64_t maxEdges = std::numeric_limits<int64_t>::max()) const;
+    // Сколько ребер добавлено, с повторами
+    [[nodiscard]] int64_t addedEdges() const;
+
+private:
+    static constexpr size_t BUCKETS = 1024;        // диапазонов вершин при раскладке, степень двойки
+    static constexpr size_t SLICE_EDGES = 1 << 16; // буферы делятся между задачами кусками такой длины
+
+    // Свой у каждого потока-производителя, пары (src, dest) упакованы в 64 бита
+    struct alignas(64) Buffer {
+        std::thread::id owner;
+        std::vector<uint64_t> edges;
+    };
+
+    Buffer &localBuffer();
+
+    int vertexCount_;
+    uint64_t id_; // отличает сборщик в кэше потока, даже если новый займет адрес старого
+    std::vector<std::atomic<int64_t>> degree_;
+    mutable br::Mutex<std::vector<std::unique_ptr<Buffer>>> buffers_;
+};
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Protocol.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Генератор нагрузки для server: несколько соединений, в каждом до depth запросов в полете.
+// Печатает пропускную способность и перцентили задержки
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string socketPath;
+    int connections = 4;
+    int requests = 10000; // на соединение
+    int depth = 16;
+    int hops = 2;
+};
+
+static void usage()
+{
+    std::cerr << "Usage: loadgen <socket-path> [--connections <n>] [--requests <per-connection>]\n"
+                 "               [--depth <in-flight>] [--hops <k>]\n";
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    if (argc < 2)
+        return false;
+    options.socketPath = argv[1];
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        int value = std::stoi(argv[i + 1]);
+        if (arg == "--connections")
+            options.connections = value;
+        else if (arg == "--requests")
+            options.requests = value;
+        else if (arg == "--depth")
+            options.depth = value;
+        else if (arg == "--hops")
+            options.hops = value;
+        else
+            return false;
+    }
+    return argc % 2 == 0 && options.connections > 0 && options.requests > 0 && options.depth > 0;
+}
+
+static int connectTo(const std::string &path)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("Socket path is too long: " + path);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0)
+            close(fd);
+        throw std::runtime_error("Failed to connect to " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+static void transfer(int fd, void *data, size_t size, bool sending)
+{
+    auto *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t done = sending ? send(fd, bytes, size, MSG_NOSIGNAL) : recv(fd, bytes, size, 0);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            throw std::runtime_error("Connection to server lost");
+        bytes += done;
+        size -= static_cast<size_t>(done);
+    }
+}
+
+static long long percentile(const std::vector<long long> &sorted, double p)
+{
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage();
+            return 1;
+        }
+
+        int vertices = 0;
+        {
+            int fd = connectTo(options.socketPath);
+            proto::Request info{0, proto::Kind::INFO, {}, 0, 0};
+            proto::Response response{};
+            transfer(fd, &info, sizeof(info), true);
+            transfer(fd, &response, sizeof(response), false);
+            close(fd);
+            vertices = static_cast<int>(response.value);
+        }
+        if (vertices <= 0)
+            throw std::runtime_error("Server reported an empty graph");
+        std::cout << "Graph has " << vertices << " vertices\n";
+
+        std::vector<std::vector<long long>> latencies(options.connections);
+        std::vector<int> failures(options.connections, 0);
+        // Исключение из тела std::thread вызвало бы std::terminate: ловим в потоке, бросаем после join
+        std::vector<std::exception_ptr> errors(options.connections);
+        std::vector<std::thread> threads;
+        auto start = Clock::now();
+        for (int c = 0; c < options.connections; ++c) {
+            threads.emplace_back([&, c] {
+                int fd = -1;
+                try {
+                    fd = connectTo(options.socketPath);
+                    std::mt19937_64 rnd(1000 + c);
+                    std::uniform_int_distribution<int> vertexDist(0, vertices - 1);
+                    std::uniform_int_distribution<int> kindDist(1, 3);
+                    std::vector<Clock::time_point> sentAt(options.requests);
+                    auto &local = latencies[c];
+                    local.reserve(options.requests);
+
+                    int sent = 0;
+                    auto sendOne = [&] {
+                        auto kind = static_cast<proto::Kind>(kindDist(rnd));
+                        int argument = kind == proto::Kind::K_HOP ? options.hops : vertexDist(rnd);
+                        proto::Request request{static_cast<uint32_t>(sent), kind, {}, vertexDist(rnd), argument};
+                        sentAt[sent++] = Clock::now();
+                        transfer(fd, &request, sizeof(request), true);
+                    };
+                    while (sent < std::min(options.depth, options.requests)) {
+                        sendOne();
+                    }
+                    for (int received = 0; received < options.requests; ++received) {
+                        proto::Response response{};
+                        transfer(fd, &response, sizeof(response), false);
+                        // id приходит от сервера: ответ на неотправленный запрос - ошибка протокола
+                        if (response.id >= static_cast<uint32_t>(sent))
+                            throw std::runtime_error("Server answered unknown request " +
+                                                     std::to_string(response.id));
+                        auto latency = Clock::now() - sentAt[response.id];
+                        local.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+                        if (response.status != proto::Status::OK)
+                            ++failures[c];
+                        if (sent < options.requests)
+                            sendOne();
+                    }
+                } catch (...) {
+                    errors[c] = std::current_exception();
+                }
+                if (fd >= 0)
+                    close(fd);
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (int c = 0; c < options.connections; ++c) {
+            if (errors[c]) {
+                std::cerr << "Connection " << c << " failed after " << latencies[c].size() << " responses\n";
+                std::rethrow_exception(errors[c]);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<long long> all;
+        for (auto &local : latencies) {
+            all.insert(all.end(), local.begin(), local.end());
+        }
+        std::sort(all.begin(), all.end());
+        int failed = 0;
+        for (int f : failures) {
+            failed += f;
+        }
+
+        std::cout << "Requests: " << all.size() << " (" << failed << " failed) in " << elapsed << " s\n";
+        std::cout << "Throughput: " << static_cast<double>(all.size()) / elapsed << " req/s\n";
+        std::cout << "Latency us: p50 " << percentile(all, 0.50) << ", p90 " << percentile(all, 0.90) << ", p99 "
+                  << percentile(all, 0.99) << ", p99.9 " << percentile(all, 0.999) << ", max " << all.back() << '\n';
+    } catch (const std::exception &ex) {
+        std::cerr << "Exception: " << ex.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "NeighborScan.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <immintrin.h>
+
+namespace {
+using ScanKernel = size_t (*)(const int *row, size_t count, const uint8_t *visited, int *out);
+
+size_t scanScalar(const int *row, size_t count, const uint8_t *visited, int *out)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int v = row[i];
+        out[found] = v;
+        found += visited[v] == 0; // без ветки: непредсказуемый visited дороже лишней записи
+    }
+    return found;
+}
+
+// Перестановки для сжатия 8 лент по маске: у AVX2 нет compress-store
+constexpr auto COMPRESS_TABLE = [] {
+    std::array<std::array<uint32_t, 8>, 256> table{};
+    for (unsigned mask = 0; mask < 256; ++mask) {
+        unsigned k = 0;
+        for (unsigned lane = 0; lane < 8; ++lane) {
+            if (mask & (1u << lane))
+                table[mask][k++] = lane;
+        }
+    }
+    return table;
+}();
+
+__attribute__((target("avx2"))) size_t scanAvx2(const int *row, size_t count, const uint8_t *visited, int *out)
+{
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i zero = _mm256_setzero_si256();
+    const auto *base = reinterpret_cast<const int *>(visited);
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i flags = _mm256_and_si256(_mm256_i32gather_epi32(base, ids, 1), byteMask);
+        auto mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(flags, zero))));
+        __m256i perm = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(COMPRESS_TABLE[mask].data()));
+        // Пишем все 8 лент: found <= i, так что запись не выходит за row.size()
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + found), _mm256_permutevar8x32_epi32(ids, perm));
+        found += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return found + scanScalar(row + i, count - i, visited, out + found);
+}
+
+__attribute__((target("avx512f"))) size_t scanAvx512(const int *row, size_t count, const uint8_t *visited,
+                                                      int *out)
+{
+    const __m512i byteMask = _mm512_set1_epi32(0xFF);
+    const auto *base = reinterpret_cast<const int *>(visited);
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i ids = _mm512_loadu_si512(row + i);
+        // Маскированная форма с полной маской: у немаскированной в GCC 12 ложное -Wmaybe-uninitialized
+        __m512i flags = _mm512_and_si512(_mm512_mask_i32gather_epi32(byteMask, 0xFFFF, ids, base, 1), byteMask);
+        __mmask16 mask = _mm512_cmpeq_epi32_mask(flags, _mm512_setzero_si512());
+        _mm512_mask_compressstoreu_epi32(out + found, mask, ids);
+        found += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    if (i < count) {
+        // Хвост той же маской: незагруженные ленты не читаются и не пишутся
+        auto tail = static_cast<__mmask16>((1u << (count - i)) - 1);
+        __m512i ids = _mm512_maskz_loadu_epi32(tail, row + i);
+        __m512i flags = _mm512_and_si512(_mm512_mask_i32gather_epi32(byteMask, tail, ids, base, 1), byteMask);
+        __mmask16 mask = _mm512_mask_cmpeq_epi32_mask(tail, flags, _mm512_setzero_si512());
+        _mm512_mask_compressstoreu_epi32(out + found, mask, ids);
+        found += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    return found;
+}
+
+struct KernelChoice {
+    ScanKernel kernel;
+    const char *name;
+};
+
+KernelChoice chooseKernel()
+{
+    __builtin_cpu_init();
+    bool avx512 = __builtin_cpu_supports("avx512f");
+    bool avx2 = __builtin_cpu_supports("avx2");
+    if (auto env = std::getenv("SCAN_KERNEL")) {
+        std::string_view wanted = env;
+        if (wanted == "scalar" || (wanted == "avx2" && avx2) || (wanted == "avx512" && avx512)) {
+            std::cerr << "Using custom neighbor scan: " << wanted << '\n';
+            if (wanted == "avx512")
+                return {scanAvx512, "avx512"};
+            if (wanted == "avx2")
+                return {scanAvx2, "avx2"};
+            return {scanScalar, "scalar"};
+        }
+        std::cerr << "Neighbor scan " << wanted << " is not supported here, falling back to auto\n";
+    }
+    if (avx512)
+        return {scanAvx512, "avx512"};
+    if (avx2)
+        return {scanAvx2, "avx2"};
+    return {scanScalar, "scalar"};
+}
+
+const KernelChoice &kernel()
+{
+    static const KernelChoice choice = chooseKernel();
+    return choice;
+}
+} // namespace
+
+size_t scanUnvisited(std::span<const int> row, const uint8_t *visited, int *out)
+{
+    return kernel().kernel(row.data(), row.size(), visited, out);
+}
+
+std::span<const int> scanToThreadBuffer(std::span<const int> row, const uint8_t *visited)
+{
+    thread_local std::vector<int> candidates;
+    if (candidates.size() < row.size())
+        candidates.resize(row.size());
+    size_t found = scanUnvisited(row, visited, candidates.data());
+    return {candidates.data(), found};
+}
+
+const char *scanKernelName()
+{
+    return kernel().name;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Векторный отбор непосещенных соседей для top-down BFS. visited - плотный массив байтов (0 - не посещена),
+// выделенный с запасом VISITED_PADDING: gather читает по 4 байта начиная с visited[v].
+// Ядро выбирается один раз по CPUID (AVX-512, AVX2 или скаляр), переменная SCAN_KERNEL позволяет
+// задать его явно для сравнения. visited читается без синхронизации, поэтому результат - только
+// кандидаты: их все равно надо захватить (CAS или повторная проверка), а дубликаты из строки отсеять
+
+constexpr size_t VISITED_PADDING = 3;
+constexpr size_t SCAN_MIN_ROW = 8; // короче вектора строку выгоднее отдать как есть, кандидатов отсеет захват
+
+// Пишет в out вершины row с visited[v] == 0 в исходном порядке, возвращает их число.
+// out должен вмещать row.size() значений
+size_t scanUnvisited(std::span<const int> row, const uint8_t *visited, int *out);
+
+std::span<const int> scanToThreadBuffer(std::span<const int> row, const uint8_t *visited);
+
+// То же, но в буфер текущего потока; span действителен до следующего вызова из этого потока
+inline std::span<const int> unvisitedNeighbors(std::span<const int> row, const uint8_t *visited)
+{
+    return row.size() < SCAN_MIN_ROW ? row : scanToThreadBuffer(row, visited);
+}
+
+const char *scanKernelName();
@@ -0,0 +1,94 @@
+#include "Numa.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+// Список процессоров в формате sysfs: "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        auto dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology readTopology()
+{
+    NumaTopology topology;
+    const std::filesystem::path root = "/sys/devices/system/node";
+    for (int node = 0;; ++node) {
+        std::ifstream in(root / ("node" + std::to_string(node)) / "cpulist");
+        std::string list;
+        if (!in || !std::getline(in, list))
+            break;
+        topology.nodeCpus.push_back(parseCpuList(list));
+    }
+    if (topology.nodeCpus.empty()) {
+        std::vector<int> all(std::max(1u, std::thread::hardware_concurrency()));
+        for (size_t cpu = 0; cpu < all.size(); ++cpu) {
+            all[cpu] = static_cast<int>(cpu);
+        }
+        topology.nodeCpus.push_back(std::move(all));
+    }
+    for (int node = 0; node < topology.nodes(); ++node) {
+        for (int cpu : topology.nodeCpus[node]) {
+            if (cpu >= static_cast<int>(topology.cpuNode.size()))
+                topology.cpuNode.resize(cpu + 1, -1);
+            topology.cpuNode[cpu] = node;
+        }
+    }
+    return topology;
+}
+} // namespace
+
+int NumaTopology::currentNode() const
+{
+    thread_local const NumaTopology *owner = nullptr;
+    thread_local int node = 0;
+    thread_local unsigned calls = 0;
+    // Адрес может достаться новой топологии с меньшим числом узлов, поэтому номер еще и проверяется
+    if (owner != this || node >= nodes() || ++calls % NODE_REFRESH_INTERVAL == 0) {
+        int cpu = sched_getcpu();
+        node = cpu >= 0 && cpu < static_cast<int>(cpuNode.size()) && cpuNode[cpu] >= 0 ? cpuNode[cpu] : 0;
+        owner = this;
+    }
+    return node;
+}
+
+const NumaTopology &numaTopology()
+{
+    static const NumaTopology topology = readTopology();
+    return topology;
+}
+
+std::thread threadOnNode(const NumaTopology &topology, int node, std::move_only_function<void()> body)
+{
+    std::vector<int> cpus = topology.nodeCpus.at(node);
+    return std::thread([cpus = std::move(cpus), body = std::move(body)] mutable {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        // Без прав на привязку поток просто останется где был: реплика будет верной, но не локальной
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        body();
+    });
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Топология NUMA из /sys/devices/system/node без libnuma. Если sysfs недоступен, вся машина - один узел
+struct NumaTopology {
+    std::vector<std::vector<int>> nodeCpus; // процессоры каждого узла
+    std::vector<int> cpuNode;               // узел каждого процессора, -1 для неизвестных
+
+    [[nodiscard]] int nodes() const
+    {
+        return static_cast<int>(nodeCpus.size());
+    }
+    // Узел процессора, на котором сейчас идет поток. Поток может мигрировать, поэтому ответ кэшируется
+    // в потоке и обновляется раз в NODE_REFRESH_INTERVAL вызовов: ошибка стоит лишь удаленного чтения
+    [[nodiscard]] int currentNode() const;
+};
+
+constexpr unsigned NODE_REFRESH_INTERVAL = 1024;
+
+const NumaTopology &numaTopology();
+
+// Поток, привязанный к процессорам узла: все, что он выделит и тронет первым, ляжет в память этого узла
+std::thread threadOnNode(const NumaTopology &topology, int node, std::move_only_function<void()> body);
@@ -0,0 +1,26 @@
+#include "Parallel.h"
+
+#include <cstdlib>
+#include <iostream>
+
+unsigned int threadCount()
+{
+    static unsigned int count = []() {
+        if (auto env = std::getenv("TP_SIZE")) {
+            auto result = std::atoi(env);
+            if (result > 0) {
+                std::cerr << "Using custom tp size: " << result << '\n';
+                return static_cast<unsigned int>(result);
+            }
+        }
+        std::cerr << "Using default hardware concurency: " << std::thread::hardware_concurrency() << '\n';
+        return std::thread::hardware_concurrency();
+    }();
+    return count;
+}
+
+br::ThreadPool &threadPool()
+{
+    static br::ThreadPool pool(threadCount());
+    return pool;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "bedrock.h"
+
+// Общий пул потоков для всех параллельных движков, размер задается переменной TP_SIZE
+unsigned int threadCount();
+br::ThreadPool &threadPool();
+
+// Как часто циклы по вершинам проверяют br::StopToken: проверка дедлайна читает часы
+constexpr size_t STOP_POLL_INTERVAL = 64;
+
+// Делит [begin, end) на не более threadCount() кусков и ждет, пока пул их обработает.
+// body(chunkBegin, chunkEnd, chunkIndex). Нельзя вызывать из задачи, уже работающей в пуле
+template <typename Body>
+void parallelFor(size_t begin, size_t end, Body &&body)
+{
+    if (begin >= end)
+        return;
+    size_t threads = threadCount();
+    size_t chunkSize = (end - begin + threads - 1) / threads;
+    size_t chunks = (end - begin + chunkSize - 1) / chunkSize;
+    if (chunks == 1) {
+        body(begin, end, size_t{0});
+        return;
+    }
+    br::WaitGroup wg(chunks);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        size_t chunkStart = begin + chunk * chunkSize;
+        size_t chunkEnd = std::min(chunkStart + chunkSize, end);
+        threadPool().Push([&, chunkStart, chunkEnd, chunk] mutable {
+            body(chunkStart, chunkEnd, chunk);
+            wg.Done();
+        });
+    }
+    wg.Wait();
+}
+
+struct NoPrefetch {
+    void operator()(std::span<const int>, size_t) const {}
+};
+
+// Один шаг level-synchronous BFS: перебирает соседей вершин фронта,
+// claim(u, v) решает, попадает ли v в следующий фронт (обычно CAS по visited).
+// Задачи опрашивают stop раз в STOP_POLL_INTERVAL вершин фронта и при остановке бросают уровень недоделанным.
+// prefetch(chunk, i) зовется перед обработкой chunk[i], chunk - фронт до конца куска задачи.
+// Следующий фронт того же типа, что и текущий: обходы держат его в br::HugeVector
+template <typename Frontier, typename Neighbors, typename Claim, typename Prefetch = NoPrefetch>
+Frontier expandFrontier(const Frontier &frontier, Neighbors &&neighbors, Claim &&claim, const br::StopToken &stop = {},
+                        Prefetch &&prefetch = {})
+{
+    br::Mutex<Frontier> nextLevel;
+    parallelFor(0, frontier.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        std::vector<int> localNextLevel;
+        std::span<const int> chunk(frontier.data(), chunkEnd);
+        for (size_t i = chunkStart; i < chunkEnd; ++i) {
+            if ((i - chunkStart) % STOP_POLL_INTERVAL == 0 && stop.StopRequested())
+                break;
+            prefetch(chunk, i);
+            int u = frontier[i];
+            for (int v : neighbors(u)) {
+                if (claim(u, v)) {
+                    localNextLevel.push_back(v);
+                }
+            }
+        }
+        if (!localNextLevel.empty()) {
+            auto nL = nextLevel.Lock();
+            nL->insert(nL->end(), localNextLevel.begin(), localNextLevel.end());
+        }
+    });
+    return std::move(*nextLevel.Lock());
+}
@@ -0,0 +1,406 @@
+#include "PartitionedBfs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+enum class Encoding : uint32_t { BITMAP = 0, DELTA };
+
+struct MessageHeader {
+    Encoding encoding;
+    uint32_t count; // вершин в сообщении, 0 - сообщения нет
+    uint64_t bytes; // размер тела после заголовка
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free, "атомики в общей памяти процессов должны быть без блокировок");
+
+// Начало общего отображения, за ним distances и почтовые ящики
+struct Control {
+    pthread_barrier_t barrier;
+    std::atomic<int64_t> active[2]; // размер следующего фронта, по четности уровня
+    std::atomic<int64_t> messages;
+    std::atomic<int64_t> messageBytes;
+    std::atomic<int64_t> uncompressedBytes;
+    std::atomic<int64_t> traversalNs;
+};
+
+constexpr size_t alignUp(size_t size)
+{
+    return (size + 63) / 64 * 64;
+}
+
+// Блок b - вершины [start(b), start(b + 1)), размеры блоков отличаются не больше чем на 1
+struct Blocks {
+    int vertices;
+    int count;
+
+    [[nodiscard]] int start(int block) const
+    {
+        return static_cast<int>(static_cast<int64_t>(vertices) * block / count);
+    }
+    [[nodiscard]] int size(int block) const
+    {
+        return start(block + 1) - start(block);
+    }
+    [[nodiscard]] int of(int vertex) const
+    {
+        auto block = static_cast<int>(static_cast<int64_t>(vertex) * count / vertices);
+        while (start(block + 1) <= vertex) {
+            ++block;
+        }
+        while (start(block) > vertex) {
+            --block;
+        }
+        return block;
+    }
+};
+
+// Ящик (from, to) пишет только from, читает только to, а барьеры разделяют запись и чтение
+class SharedRegion {
+public:
+    SharedRegion(int vertices, int processes, size_t slotBytes)
+        : processes_(processes), slotBytes_(alignUp(slotBytes)),
+          distancesOffset_(alignUp(sizeof(Control))),
+          slotsOffset_(distancesOffset_ + alignUp(sizeof(int) * static_cast<size_t>(vertices))),
+          size_(slotsOffset_ + slotBytes_ * static_cast<size_t>(processes) * processes)
+    {
+        data_ = static_cast<uint8_t *>(mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        if (data_ == MAP_FAILED)
+            throw std::runtime_error(std::string("Failed to map partition channels: ") + std::strerror(errno));
+        auto *control = new (data_) Control{};
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(&control->barrier, &attr, static_cast<unsigned>(processes));
+        pthread_barrierattr_destroy(&attr);
+        std::fill_n(distances(), vertices, -1);
+    }
+
+    ~SharedRegion()
+    {
+        pthread_barrier_destroy(&control().barrier);
+        control().~Control();
+        munmap(data_, size_);
+    }
+
+    SharedRegion(const SharedRegion &) = delete;
+    SharedRegion &operator=(const SharedRegion &) = delete;
+
+    Control &control()
+    {
+        return *reinterpret_cast<Control *>(data_);
+    }
+    int *distances()
+    {
+        return reinterpret_cast<int *>(data_ + distancesOffset_);
+    }
+    uint8_t *slot(int from, int to)
+    {
+        return data_ + slotsOffset_ + slotBytes_ * (static_cast<size_t>(from) * processes_ + to);
+    }
+    void wait()
+    {
+        pthread_barrier_wait(&control().barrier);
+    }
+
+private:
+    int processes_;
+    size_t slotBytes_;
+    size_t distancesOffset_;
+    size_t slotsOffset_;
+    size_t size_;
+    uint8_t *data_;
+};
+
+size_t varintBytes(uint32_t value)
+{
+    size_t bytes = 1;
+    for (; value >= 0x80; value >>= 7) {
+        ++bytes;
+    }
+    return bytes;
+}
+
+// vertices отсортированы, без повторов и лежат в блоке [blockStart, blockStart + blockSize).
+// Дельты выбираются, только если короче карты, поэтому ящику хватает места под карту самого большого блока
+void sendVertices(SharedRegion &shared, int from, int to, std::span<const int> vertices, int blockStart,
+                  int blockSize)
+{
+    auto *header = reinterpret_cast<MessageHeader *>(shared.slot(from, to));
+    auto *body = reinterpret_cast<uint8_t *>(header + 1);
+    header->count = static_cast<uint32_t>(vertices.size());
+    if (vertices.empty())
+        return;
+
+    size_t deltaBytes = 0;
+    int previous = blockStart;
+    for (int v : vertices) {
+        deltaBytes += varintBytes(static_cast<uint32_t>(v - previous));
+        previous = v;
+    }
+    size_t bitmapBytes = (static_cast<size_t>(blockSize) + 7) / 8;
+    if (deltaBytes < bitmapBytes) {
+        header->encoding = Encoding::DELTA;
+        header->bytes = deltaBytes;
+        previous = blockStart;
+        for (int v : vertices) {
+            auto delta = static_cast<uint32_t>(v - previous);
+            for (; delta >= 0x80; delta >>= 7) {
+                *body++ = static_cast<uint8_t>(delta | 0x80);
+            }
+            *body++ = static_cast<uint8_t>(delta);
+            previous = v;
+        }
+    } else {
+        header->encoding = Encoding::BITMAP;
+        header->bytes = bitmapBytes;
+        std::memset(body, 0, bitmapBytes);
+        for (int v : vertices) {
+            int bit = v - blockStart;
+            body[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+    auto &control = shared.control();
+    control.messages.fetch_add(1, std::memory_order_relaxed);
+    control.messageBytes.fetch_add(static_cast<int64_t>(sizeof(MessageHeader) + header->bytes),
+                                   std::memory_order_relaxed);
+    control.uncompressedBytes.fetch_add(static_cast<int64_t>(sizeof(int) * vertices.size()),
+                                        std::memory_order_relaxed);
+}
+
+template <typename F>
+void receiveVertices(SharedRegion &shared, int from, int to, int blockStart, F &&f)
+{
+    const auto *header = reinterpret_cast<const MessageHeader *>(shared.slot(from, to));
+    const auto *body = reinterpret_cast<const uint8_t *>(header + 1);
+    if (header->count == 0)
+        return;
+    if (header->encoding == Encoding::DELTA) {
+        int v = blockStart;
+        for (uint32_t k = 0; k < header->count; ++k) {
+            uint32_t delta = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t byte = *body++;
+                delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    break;
+            }
+            v += static_cast<int>(delta);
+            f(v);
+        }
+        return;
+    }
+    for (size_t i = 0; i < header->bytes; ++i) {
+        for (unsigned bits = body[i]; bits != 0; bits &= bits - 1) {
+            f(blockStart + static_cast<int>(i * 8) + __builtin_ctz(bits));
+        }
+    }
+}
+
+void sortUnique(std::vector<int> &vertices)
+{
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+}
+
+// Процесс p = (p % rows, p / rows) владеет блоком p
+void runWorker(const Graph &g, int startVertex, PartitionGrid grid, int p, SharedRegion &shared)
+{
+    const Blocks blocks{g.vertices(), grid.processes()};
+    const int row = p % grid.rows;
+    const int col = p / grid.rows;
+    const int ownStart = blocks.start(p);
+
+    // Свой кусок смежности: строки вершин столбца, только ребра во владения своей строки сетки
+    const int colStart = blocks.start(col * grid.rows);
+    const int colEnd = blocks.start((col + 1) * grid.rows);
+    std::vector<int64_t> offsets(static_cast<size_t>(colEnd - colStart) + 1, 0);
+    std::vector<int> targets;
+    for (int u = colStart; u < colEnd; ++u) {
+        for (int v : g.neighbors(u)) {
+            if (grid.rows == 1 || blocks.of(v) % grid.rows == row)
+                targets.push_back(v);
+        }
+        offsets[u - colStart + 1] = static_cast<int64_t>(targets.size());
+    }
+
+    int *distances = shared.distances();
+    std::vector<uint8_t> visited(blocks.size(p), 0);
+    auto claim = [&](int v, int depth, std::vector<int> &level) {
+        auto &seen = visited[v - ownStart];
+        if (seen)
+            return;
+        seen = 1;
+        distances[v] = depth;
+        level.push_back(v);
+    };
+    std::vector<int> frontier;
+    if (blocks.of(startVertex) == p)
+        claim(startVertex, 0, frontier);
+
+    auto &control = shared.control();
+    shared.wait();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<int>> candidates(grid.cols); // по столбцу владельца в своей строке
+    for (int depth = 0;; ++depth) {
+        // expand: свой фронт - остальным процессам столбца
+        std::vector<int> columnFrontier = frontier;
+        if (grid.rows > 1) {
+            std::sort(frontier.begin(), frontier.end());
+            for (int peer = col * grid.rows; peer < (col + 1) * grid.rows; ++peer) {
+                if (peer != p)
+                    sendVertices(shared, p, peer, frontier, ownStart, blocks.size(p));
+            }
+            shared.wait();
+            for (int peer = col * grid.rows; peer < (col + 1) * grid.rows; ++peer) {
+                if (peer != p)
+                    receiveVertices(shared, peer, p, blocks.start(peer),
+                                    [&](int v) { columnFrontier.push_back(v); });
+            }
+        }
+
+        // fold: кандидаты следующего уровня - их владельцам в своей строке
+        for (int u : columnFrontier) {
+            for (int64_t e = offsets[u - colStart]; e < offsets[u - colStart + 1]; ++e) {
+                candidates[blocks.of(targets[e]) / grid.rows].push_back(targets[e]);
+            }
+        }
+        std::vector<int> next;
+        for (int peerCol = 0; peerCol < grid.cols; ++peerCol) {
+            int peer = peerCol * grid.rows + row;
+            if (peer == p) {
+                for (int v : candidates[peerCol]) {
+                    claim(v, depth + 1, next);
+                }
+            } else {
+                sortUnique(candidates[peerCol]);
+                sendVertices(shared, p, peer, candidates[peerCol], blocks.start(peer), blocks.size(peer));
+            }
+            candidates[peerCol].clear();
+        }
+        shared.wait();
+        for (int peerCol = 0; peerCol < grid.cols; ++peerCol) {
+            int peer = peerCol * grid.rows + row;
+            if (peer != p)
+                receiveVertices(shared, peer, p, ownStart, [&](int v) { claim(v, depth + 1, next); });
+        }
+
+        // Счетчик другой четности обнуляется, когда все уже прочли его на прошлом уровне
+        // и еще не могут начать прибавлять к нему на следующем
+        auto &active = control.active[depth % 2];
+        active.fetch_add(static_cast<int64_t>(next.size()), std::memory_order_relaxed);
+        shared.wait();
+        if (active.load(std::memory_order_relaxed) == 0)
+            break;
+        if (p == 0)
+            control.active[(depth + 1) % 2].store(0, std::memory_order_relaxed);
+        frontier = std::move(next);
+    }
+    if (p == 0)
+        control.traversalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+}
+} // namespace
+
+PartitionGrid PartitionGrid::oneD(int processes)
+{
+    return {1, processes};
+}
+
+PartitionGrid PartitionGrid::twoD(int processes)
+{
+    auto rows = static_cast<int>(std::sqrt(static_cast<double>(processes)));
+    while (rows > 1 && processes % rows != 0) {
+        --rows;
+    }
+    rows = std::max(rows, 1);
+    return {rows, processes / rows};
+}
+
+PartitionedBfsResult partitionedBfs(const Graph &g, int startVertex, PartitionGrid grid)
+{
+    if (grid.rows < 1 || grid.cols < 1)
+        throw std::invalid_argument("Partition grid must have at least one row and column");
+    const int n = g.vertices();
+    PartitionedBfsResult result{std::vector<int>(n, -1)};
+    if (startVertex < 0 || startVertex >= n)
+        return result;
+
+    const int processes = grid.processes();
+    const Blocks blocks{n, processes};
+    int largestBlock = 0;
+    for (int block = 0; block < processes; ++block) {
+        largestBlock = std::max(largestBlock, blocks.size(block));
+    }
+    SharedRegion shared(n, processes, sizeof(MessageHeader) + (static_cast<size_t>(largestBlock) + 7) / 8);
+
+    // Все рабочие - в одной группе процессов: ее можно ждать и убить целиком, не трогая чужих детей
+    const pid_t parent = getpid();
+    pid_t group = 0;
+    int started = 0;
+    for (; started < processes; ++started) {
+        pid_t pid = fork();
+        if (pid < 0)
+            break;
+        if (pid == 0) {
+            // Без родителя рабочие навсегда встали бы на барьере
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent)
+                _exit(1);
+            setpgid(0, group);
+            try {
+                runWorker(g, startVertex, grid, started, shared);
+            } catch (...) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        if (group == 0)
+            group = pid;
+        setpgid(pid, group); // и в родителе: иначе wait мог бы начаться раньше, чем ребенок вступит в группу
+    }
+
+    bool failed = started < processes;
+    if (failed && group != 0)
+        kill(-group, SIGKILL);
+    for (int left = started; left > 0;) {
+        siginfo_t info{};
+        if (waitid(P_PGID, static_cast<id_t>(group), &info, WEXITED) != 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        --left;
+        if (info.si_code != CLD_EXITED || info.si_status != 0) {
+            if (!failed)
+                kill(-group, SIGKILL);
+            failed = true;
+        }
+    }
+    if (failed)
+        throw std::runtime_error("Partitioned BFS worker failed");
+
+    auto &control = shared.control();
+    std::copy_n(shared.distances(), n, result.distances.begin());
+    result.traversalTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::nanoseconds(control.traversalNs.load()));
+    result.messages = control.messages.load();
+    result.messageBytes = control.messageBytes.load();
+    result.uncompressedBytes = control.uncompressedBytes.load();
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "Graph.h"
+
+// Сетка процессов rows x cols для BFS в стиле распределенной памяти на одной машине: каждый процесс -
+// отдельный "узел" со своим куском смежности, фронт между ними ходит только сообщениями.
+// Вершины делятся на rows * cols блоков, процесс (i, j) владеет блоком j * rows + i.
+// Процесс хранит ребра u -> v, где u из блоков своего столбца j, а владелец v - в его строке i.
+// Уровень: фронт собирается внутри столбца (expand), кандидаты уходят владельцам внутри строки (fold),
+// так что каждому процессу нужны rows + cols - 2 собеседника вместо rows * cols - 1.
+// 1D-разбиение - сетка 1 x K: у процесса строки своих вершин целиком, а кандидаты уходят всем
+struct PartitionGrid {
+    int rows = 1;
+    int cols = 1;
+
+    [[nodiscard]] int processes() const
+    {
+        return rows * cols;
+    }
+
+    static PartitionGrid oneD(int processes);
+    // Сетка, ближайшая к квадратной: rows - наибольший делитель processes, не больший корня
+    static PartitionGrid twoD(int processes);
+};
+
+struct PartitionedBfsResult {
+    std::vector<int> distances;            // -1 для недостижимых
+    std::chrono::milliseconds traversalTime{0}; // без запуска процессов и раздачи им кусков графа
+    int64_t messages = 0;                  // непустых сообщений между процессами
+    int64_t messageBytes = 0;              // их размер после сжатия
+    int64_t uncompressedBytes = 0;         // те же вершины списком int32
+};
+
+// BFS по графу, разбитому между grid.processes() дочерними процессами (fork). Процессы строят свои
+// куски из унаследованного графа и дальше читают только их; обмен - почтовые ящики в общей анонимной
+// памяти и межпроцессный барьер. Сообщение - множество вершин блока битовой картой или отсортированным
+// списком разностей в varint, что короче. Если процесс упал, остальные убиваются и летит std::runtime_error.
+// Пул потоков в детях не используется: после fork от него остается только вызвавший поток
+PartitionedBfsResult partitionedBfs(const Graph &g, int startVertex, PartitionGrid grid);
@@ -0,0 +1,45 @@
+#include "Prefetch.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+constexpr PrefetchDistances DEFAULT_DISTANCES{4, 2};
+
+struct Distances {
+    std::atomic<size_t> row;
+    std::atomic<size_t> visited;
+};
+
+Distances &distances()
+{
+    static Distances current = [] {
+        PrefetchDistances initial = DEFAULT_DISTANCES;
+        if (auto env = std::getenv("BFS_PREFETCH")) {
+            size_t row = 0;
+            size_t visited = 0;
+            if (std::sscanf(env, "%zu,%zu", &row, &visited) == 2) {
+                std::cerr << "Using custom prefetch distances: " << row << ',' << visited << '\n';
+                initial = {row, visited};
+            }
+        }
+        return Distances{initial.row, initial.visited};
+    }();
+    return current;
+}
+} // namespace
+
+PrefetchDistances prefetchDistances()
+{
+    auto &d = distances();
+    return {d.row.load(std::memory_order_relaxed), d.visited.load(std::memory_order_relaxed)};
+}
+
+void setPrefetchDistances(PrefetchDistances value)
+{
+    auto &d = distances();
+    d.row.store(value.row, std::memory_order_relaxed);
+    d.visited.store(value.visited, std::memory_order_relaxed);
+}
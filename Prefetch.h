@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+// Дистанции программной предвыборки в BFS-ядрах, в вершинах очереди (0 - ступень выключена).
+//   row     - за сколько вершин вперед тянуть начало строки соседей (смещение строки - за 2 * row)
+//   visited - за сколько вершин вперед тянуть байты visited соседей, должна быть меньше row:
+//             к этому моменту строка соседей уже в кэше
+// Начальные значения берутся из BFS_PREFETCH="row,visited", ядра читают их в начале обхода
+struct PrefetchDistances {
+    size_t row;
+    size_t visited;
+};
+
+PrefetchDistances prefetchDistances();
+void setPrefetchDistances(PrefetchDistances distances);
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Бинарный протокол сервера запросов: сообщения фиксированного размера, порядок байт хоста
+// (сервер и клиенты живут на одной машине). Ответ несет id запроса, порядок ответов не гарантирован
+namespace proto {
+enum class Kind : uint8_t {
+    INFO = 0,      // value = число вершин графа
+    REACHABLE = 1, // value = 1, если argument достижима из source
+    DISTANCE = 2,  // value = длина кратчайшего пути до argument или -1
+    K_HOP = 3,     // value = число вершин не дальше argument шагов от source
+};
+
+enum class Status : int32_t { OK = 0, BAD_REQUEST = 1 };
+
+struct Request {
+    uint32_t id;
+    Kind kind;
+    uint8_t reserved[3];
+    int32_t source;
+    int32_t argument;
+};
+
+struct Response {
+    uint32_t id;
+    Status status;
+    int64_t value;
+};
+
+static_assert(sizeof(Request) == 16);
+static_assert(sizeof(Response) == 16);
+} // namespace proto
@@ -0,0 +1,402 @@
+#include "QueryEngine.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+// Ниже этого размера параллельный обход одного запроса не окупает синхронизацию уровней
+constexpr int LATENCY_MIN_VERTICES = 1 << 16;
+constexpr size_t SOURCES_PER_GROUP = 64;
+// Уровни уже этого обходятся в вызывающем потоке: раздача в пул дороже самой работы
+constexpr size_t PARALLEL_FRONTIER = 4096;
+} // namespace
+
+QueryEngine::Context::Context(int vertices) : depth(vertices), isTarget(vertices, 0)
+{
+    for (auto &d : depth) {
+        d.store(-1, std::memory_order_relaxed);
+    }
+}
+
+QueryEngine::MultiSourceContext::MultiSourceContext(int vertices)
+    : seen(vertices, 0), visit(vertices, 0), visitNext(vertices, 0)
+{
+}
+
+QueryEngine::QueryEngine(const Graph &g) : graph_(g) {}
+
+QueryEngine::~QueryEngine() = default;
+
+QueryEngine::Mode QueryEngine::chooseMode(size_t batchSize) const
+{
+    // Пакет занимает весь пул сам по себе или граф маленький - выгоднее независимые обходы
+    if (batchSize >= threadCount() || graph_.vertices() < LATENCY_MIN_VERTICES)
+        return Mode::THROUGHPUT;
+    return Mode::LATENCY;
+}
+
+std::vector<QueryEngine::Result> QueryEngine::run(const std::vector<int> &roots, Mode mode, bool keepDistances,
+                                                  const br::StopToken &stop)
+{
+    auto accepted = std::chrono::steady_clock::now();
+    std::vector<Result> results(roots.size());
+    if (mode == Mode::AUTO)
+        mode = chooseMode(roots.size());
+
+    auto execute = [&](Context &context, size_t i, bool parallel) {
+        auto start = std::chrono::steady_clock::now();
+        results[i].root = roots[i];
+        if (stop.StopRequested()) {
+            results[i].status = traversalStatus(stop);
+        } else if (roots[i] >= 0 && roots[i] < graph_.vertices()) {
+            if (parallel)
+                parallelQuery(context, roots[i], results[i], keepDistances, stop);
+            else
+                serialQuery(context, roots[i], results[i], keepDistances, stop);
+        }
+        auto end = std::chrono::steady_clock::now();
+        results[i].serviceTime = end - start;
+        results[i].latency = end - accepted;
+    };
+
+    if (mode == Mode::LATENCY) {
+        auto context = acquire(contexts_);
+        for (size_t i = 0; i < roots.size(); ++i) {
+            execute(*context, i, true);
+        }
+        release(contexts_, std::move(context));
+        return results;
+    }
+
+    // Запросы разбираются динамически: обходы из разных корней сильно отличаются по стоимости
+    std::atomic<size_t> next{0};
+    size_t workers = std::min<size_t>(threadCount(), roots.size());
+    br::WaitGroup wg(workers);
+    for (size_t w = 0; w < workers; ++w) {
+        threadPool().Push([&] mutable {
+            auto context = acquire(contexts_);
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < roots.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed)) {
+                execute(*context, i, false);
+            }
+            release(contexts_, std::move(context));
+            wg.Done();
+        });
+    }
+    wg.Wait();
+    return results;
+}
+
+void QueryEngine::serialQuery(Context &context, int root, Result &result, bool keepDistances,
+                              const br::StopToken &stop) const
+{
+    auto &depth = context.depth;
+    auto &order = context.order;
+    order.clear();
+    order.push_back(root);
+    depth[root].store(0, std::memory_order_relaxed);
+
+    for (size_t head = 0; head < order.size(); ++head) {
+        if (head % STOP_POLL_INTERVAL == 0 && stop.StopRequested()) {
+            result.status = traversalStatus(stop);
+            break;
+        }
+        int u = order[head];
+        int du = depth[u].load(std::memory_order_relaxed);
+        if (static_cast<size_t>(du) == result.levelSizes.size())
+            result.levelSizes.push_back(0);
+        ++result.levelSizes[du];
+        for (int v : graph_.neighbors(u)) {
+            if (depth[v].load(std::memory_order_relaxed) < 0) {
+                depth[v].store(du + 1, std::memory_order_relaxed);
+                order.push_back(v);
+            }
+        }
+    }
+
+    result.reached = static_cast<int64_t>(order.size());
+    if (keepDistances) {
+        result.distances.assign(graph_.vertices(), -1);
+        for (int v : order) {
+            result.distances[v] = depth[v].load(std::memory_order_relaxed);
+        }
+    }
+    for (int v : order) {
+        depth[v].store(-1, std::memory_order_relaxed);
+    }
+}
+
+void QueryEngine::parallelQuery(Context &context, int root, Result &result, bool keepDistances,
+                                const br::StopToken &stop) const
+{
+    auto &depth = context.depth;
+    auto &order = context.order;
+    order.clear();
+    order.push_back(root);
+    depth[root].store(0, std::memory_order_relaxed);
+
+    std::vector<int> currentLevel{root};
+    for (int d = 0; !currentLevel.empty(); ++d) {
+        if (stop.StopRequested())
+            break;
+        result.levelSizes.push_back(static_cast<int>(currentLevel.size()));
+        currentLevel = expandFrontier(
+            currentLevel, [&](int u) { return graph_.neighbors(u); },
+            [&](int, int v) {
+                int expected = -1;
+                return depth[v].compare_exchange_strong(expected, d + 1, std::memory_order_relaxed);
+            },
+            stop);
+        order.insert(order.end(), currentLevel.begin(), currentLevel.end());
+    }
+    result.status = traversalStatus(stop);
+
+    result.reached = static_cast<int64_t>(order.size());
+    if (keepDistances) {
+        result.distances.assign(graph_.vertices(), -1);
+        for (int v : order) {
+            result.distances[v] = depth[v].load(std::memory_order_relaxed);
+        }
+    }
+    for (int v : order) {
+        depth[v].store(-1, std::memory_order_relaxed);
+    }
+}
+
+QueryEngine::Neighborhood QueryEngine::neighborhood(int root, int maxDepth, std::span<const int> targets,
+                                                    const br::StopToken &stop)
+{
+    Neighborhood result;
+    if (root < 0 || root >= graph_.vertices())
+        return result;
+
+    auto context = acquire(contexts_);
+    auto &depth = context->depth;
+    auto &order = context->order;
+    auto &isTarget = context->isTarget;
+    size_t targetCount = 0;
+    for (int t : targets) {
+        if (t >= 0 && t < graph_.vertices() && !isTarget[t]) {
+            isTarget[t] = 1;
+            ++targetCount;
+        }
+    }
+
+    // Нахождение всех целей останавливает обход так же, как внешний токен, но статусом не считается
+    br::StopSource done(stop);
+    auto halt = done.Token();
+    std::atomic<size_t> found{0};
+    auto discover = [&](int v) {
+        if (isTarget[v] && found.fetch_add(1, std::memory_order_relaxed) + 1 == targetCount)
+            done.RequestStop();
+    };
+
+    order.clear();
+    order.push_back(root);
+    depth[root].store(0, std::memory_order_relaxed);
+    discover(root);
+    result.levelStarts = {0, 1};
+
+    std::vector<int> frontier{root};
+    std::vector<int> next;
+    for (int d = 0; !frontier.empty() && !halt.StopRequested() && (maxDepth < 0 || d < maxDepth); ++d) {
+        if (frontier.size() < PARALLEL_FRONTIER) {
+            next.clear();
+            for (size_t i = 0; i < frontier.size(); ++i) {
+                if (i % STOP_POLL_INTERVAL == 0 && halt.StopRequested())
+                    break;
+                for (int v : graph_.neighbors(frontier[i])) {
+                    if (depth[v].load(std::memory_order_relaxed) < 0) {
+                        depth[v].store(d + 1, std::memory_order_relaxed);
+                        next.push_back(v);
+                        discover(v);
+                    }
+                }
+            }
+        } else {
+            next = expandFrontier(
+                frontier, [&](int u) { return graph_.neighbors(u); },
+                [&](int, int v) {
+                    int expected = -1;
+                    if (!depth[v].compare_exchange_strong(expected, d + 1, std::memory_order_relaxed))
+                        return false;
+                    discover(v);
+                    return true;
+                },
+                halt);
+        }
+        if (next.empty())
+            break;
+        order.insert(order.end(), next.begin(), next.end());
+        result.levelStarts.push_back(order.size());
+        frontier.swap(next);
+    }
+
+    result.vertices = order;
+    result.targetsFound = found.load(std::memory_order_relaxed);
+    if (targetCount == 0 || result.targetsFound < targetCount)
+        result.status = traversalStatus(stop);
+    for (int v : order) {
+        depth[v].store(-1, std::memory_order_relaxed);
+    }
+    for (int t : targets) {
+        if (t >= 0 && t < graph_.vertices())
+            isTarget[t] = 0;
+    }
+    release(contexts_, std::move(context));
+    return result;
+}
+
+std::vector<int64_t> QueryEngine::answer(const std::vector<PointQuery> &queries)
+{
+    std::vector<int64_t> answers(queries.size(), -1);
+    std::vector<size_t> order;
+    order.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto &q = queries[i];
+        bool validArgument = q.kind == PointQuery::Kind::K_HOP ? q.argument >= 0
+                                                                : q.argument >= 0 && q.argument < graph_.vertices();
+        if (q.source >= 0 && q.source < graph_.vertices() && validArgument)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return queries[a].source < queries[b].source; });
+
+    // Группа - подряд идущие запросы, у которых не больше 64 различных источников
+    std::vector<std::span<const size_t>> groups;
+    for (size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+        size_t distinct = 0;
+        for (end = begin; end < order.size(); ++end) {
+            if (end == begin || queries[order[end]].source != queries[order[end - 1]].source) {
+                if (distinct == SOURCES_PER_GROUP)
+                    break;
+                ++distinct;
+            }
+        }
+        groups.emplace_back(order.data() + begin, end - begin);
+    }
+
+    std::atomic<size_t> next{0};
+    size_t workers = std::min<size_t>(threadCount(), groups.size());
+    br::WaitGroup wg(workers);
+    for (size_t w = 0; w < workers; ++w) {
+        threadPool().Push([&] mutable {
+            auto context = acquire(multiSourceContexts_);
+            for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < groups.size();
+                 i = next.fetch_add(1, std::memory_order_relaxed)) {
+                multiSourceQuery(*context, queries, groups[i], answers);
+            }
+            release(multiSourceContexts_, std::move(context));
+            wg.Done();
+        });
+    }
+    wg.Wait();
+    return answers;
+}
+
+void QueryEngine::multiSourceQuery(MultiSourceContext &context, const std::vector<PointQuery> &queries,
+                                   std::span<const size_t> group, std::vector<int64_t> &answers) const
+{
+    auto &[seen, visit, visitNext, reached] = context;
+    std::vector<int> sources;
+    std::vector<int> bitOf(group.size());
+    for (size_t i = 0; i < group.size(); ++i) {
+        int source = queries[group[i]].source;
+        if (sources.empty() || sources.back() != source)
+            sources.push_back(source);
+        bitOf[i] = static_cast<int>(sources.size()) - 1;
+    }
+
+    // Запросы к целям ждут, пока бит источника не появится у цели; k-hop копят счетчики по уровням
+    std::vector<size_t> pendingTargets;
+    int maxHops = 0;
+    for (size_t i = 0; i < group.size(); ++i) {
+        const auto &q = queries[group[i]];
+        if (q.kind == PointQuery::Kind::K_HOP) {
+            maxHops = std::max(maxHops, q.argument);
+            answers[group[i]] = 0;
+        } else {
+            pendingTargets.push_back(i);
+        }
+    }
+    auto hopMask = [&](int level) {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < group.size(); ++i) {
+            const auto &q = queries[group[i]];
+            if (q.kind == PointQuery::Kind::K_HOP && q.argument >= level)
+                mask |= uint64_t{1} << bitOf[i];
+        }
+        return mask;
+    };
+
+    std::vector<int64_t> levelCount(sources.size());
+    auto finishLevel = [&](int level, const std::vector<int> &discovered) {
+        uint64_t mask = hopMask(level);
+        if (mask != 0) {
+            std::fill(levelCount.begin(), levelCount.end(), 0);
+            for (int v : discovered) {
+                for (uint64_t bits = visit[v] & mask; bits != 0; bits &= bits - 1) {
+                    ++levelCount[std::countr_zero(bits)];
+                }
+            }
+            for (size_t i = 0; i < group.size(); ++i) {
+                const auto &q = queries[group[i]];
+                if (q.kind == PointQuery::Kind::K_HOP && q.argument >= level)
+                    answers[group[i]] += levelCount[bitOf[i]];
+            }
+        }
+        std::erase_if(pendingTargets, [&](size_t i) {
+            const auto &q = queries[group[i]];
+            if ((seen[q.argument] >> bitOf[i] & 1) == 0)
+                return false;
+            answers[group[i]] = q.kind == PointQuery::Kind::DISTANCE ? level : 1;
+            return true;
+        });
+    };
+
+    std::vector<int> frontier;
+    for (size_t b = 0; b < sources.size(); ++b) {
+        int s = sources[b];
+        seen[s] = visit[s] = uint64_t{1} << b;
+        frontier.push_back(s);
+        reached.push_back(s);
+    }
+    finishLevel(0, frontier);
+
+    std::vector<int> next;
+    for (int level = 1; !frontier.empty() && (!pendingTargets.empty() || level <= maxHops); ++level) {
+        next.clear();
+        for (int u : frontier) {
+            uint64_t bits = visit[u];
+            for (int v : graph_.neighbors(u)) {
+                uint64_t fresh = bits & ~seen[v];
+                if (fresh != 0) {
+                    if (visitNext[v] == 0)
+                        next.push_back(v);
+                    visitNext[v] |= fresh;
+                }
+            }
+        }
+        for (int u : frontier) {
+            visit[u] = 0;
+        }
+        for (int v : next) {
+            if (seen[v] == 0)
+                reached.push_back(v);
+            seen[v] |= visitNext[v];
+            visit[v] = visitNext[v];
+            visitNext[v] = 0;
+        }
+        frontier.swap(next);
+        finishLevel(level, frontier);
+    }
+
+    for (size_t i : pendingTargets) {
+        answers[group[i]] = queries[group[i]].kind == PointQuery::Kind::DISTANCE ? -1 : 0;
+    }
+    for (int v : reached) {
+        seen[v] = visit[v] = 0;
+    }
+    reached.clear();
+}
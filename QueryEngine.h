@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include "Graph.h"
+#include "bedrock.h"
+
+// Пакетное выполнение запросов "BFS из вершины r" над одним общим графом
+class QueryEngine {
+public:
+    enum class Mode : uint8_t {
+        AUTO = 0,   // выбрать по размеру пакета и графа
+        THROUGHPUT, // каждый запрос - последовательный BFS, запросы параллельно друг другу
+        LATENCY,    // запросы по очереди, каждый - параллельный BFS на весь пул
+    };
+
+    struct Result {
+        int root = -1;
+        int64_t reached = 0;
+        std::vector<int> levelSizes;         // сколько вершин на каждом уровне, size() - 1 = эксцентриситет
+        std::vector<int> distances;          // заполняется только при keepDistances
+        std::chrono::nanoseconds latency{};  // от приема пакета до готовности ответа
+        std::chrono::nanoseconds serviceTime{}; // собственно обход
+        // При остановке обход обрывается, а еще не начатые запросы пакета не выполняются вовсе
+        TraversalStatus status = TraversalStatus::COMPLETED;
+    };
+
+    struct PointQuery {
+        enum class Kind : uint8_t { REACHABLE = 1, DISTANCE, K_HOP };
+
+        Kind kind;
+        int source;
+        int argument; // цель для REACHABLE и DISTANCE, k для K_HOP
+    };
+
+    struct Neighborhood {
+        std::vector<int> vertices;       // достигнутые вершины по уровням, начиная с корня
+        std::vector<size_t> levelStarts; // уровень d - vertices[levelStarts[d]..levelStarts[d + 1])
+        size_t targetsFound = 0;         // различных целей среди vertices
+        TraversalStatus status = TraversalStatus::COMPLETED;
+    };
+
+    explicit QueryEngine(const Graph &g);
+    ~QueryEngine();
+
+    std::vector<Result> run(const std::vector<int> &roots, Mode mode = Mode::AUTO, bool keepDistances = false,
+                            const br::StopToken &stop = {});
+    [[nodiscard]] Mode chooseMode(size_t batchSize) const;
+
+    // Запросы склеиваются по источникам в битовые обходы до 64 источников за раз (MS-BFS).
+    // Ответ: 1/0 для REACHABLE, расстояние или -1 для DISTANCE, число вершин не дальше k для K_HOP;
+    // -1, если вершина запроса вне графа
+    std::vector<int64_t> answer(const std::vector<PointQuery> &queries);
+
+    // Обход из root не дальше maxDepth уровней (-1 - без ограничения), который обрывается, как только
+    // найдены все targets; тогда последний уровень может быть неполным. Стоит O(окрестности), а не O(V):
+    // массивы берутся из пула и сбрасываются только в тронутых вершинах. Широкие уровни идут через пул
+    Neighborhood neighborhood(int root, int maxDepth, std::span<const int> targets = {},
+                              const br::StopToken &stop = {});
+
+private:
+    // Рабочие массивы одного обхода, переиспользуются между запросами
+    struct Context {
+        explicit Context(int vertices);
+
+        std::vector<std::atomic<int>> depth; // -1 у непосещенных, сбрасываются только тронутые
+        std::vector<int> order;
+        std::vector<char> isTarget;
+    };
+
+    // Маски источников на вершину: кто уже дошел, кто во фронте текущего и следующего уровня
+    struct MultiSourceContext {
+        explicit MultiSourceContext(int vertices);
+
+        std::vector<uint64_t> seen;
+        std::vector<uint64_t> visit;
+        std::vector<uint64_t> visitNext;
+        std::vector<int> reached;
+    };
+
+    template <typename T>
+    using ContextPool = br::Mutex<std::vector<std::unique_ptr<T>>>;
+
+    template <typename T>
+    std::unique_ptr<T> acquire(ContextPool<T> &pool) const
+    {
+        {
+            auto free = pool.Lock();
+            if (!free->empty()) {
+                auto context = std::move(free->back());
+                free->pop_back();
+                return context;
+            }
+        }
+        return std::make_unique<T>(graph_.vertices());
+    }
+
+    template <typename T>
+    static void release(ContextPool<T> &pool, std::unique_ptr<T> context)
+    {
+        pool.Lock()->push_back(std::move(context));
+    }
+
+    void serialQuery(Context &context, int root, Result &result, bool keepDistances,
+                     const br::StopToken &stop) const;
+    void parallelQuery(Context &context, int root, Result &result, bool keepDistances,
+                       const br::StopToken &stop) const;
+    void multiSourceQuery(MultiSourceContext &context, const std::vector<PointQuery> &queries,
+                          std::span<const size_t> group, std::vector<int64_t> &answers) const;
+
+    const Graph &graph_;
+    ContextPool<Context> contexts_;
+    ContextPool<MultiSourceContext> multiSourceContexts_;
+};
@@ -1,10 +1,16 @@
 #include "RandomGraphGenerator.h"
+#include "GraphBuilder.h"
 #include <algorithm>
+#include <exception>
 #include <numeric>
 #include <stdexcept>
 #include <thread>
 
-Graph RandomGraphGenerator::generateGraph(std::mt19937_64& r, int size, int numEdges) {
+namespace {
+constexpr size_t STOP_POLL_KEYS = 1 << 16; // потоки генерации проверяют токен раз в столько ключей
+}
+
+Graph RandomGraphGenerator::generateGraph(std::mt19937_64& r, int size, int numEdges, const br::StopToken& stop) {
     if (numEdges < size - 1) {
         throw std::invalid_argument("We need min size-1 edges");
     }
@@ -22,66 +28,152 @@ Graph RandomGraphGenerator::generateGraph(std::mt19937_64& r, int size, int numE
         std::swap(perm[i], perm[j]);
     }
 
-    const int chainCount = size - 1;
-    const int needMore = numEdges - chainCount;
+    const int needMore = numEdges - (size - 1);
     const int oversample = std::max(needMore / 50, 100000);
-    const size_t toGenerate = static_cast<size_t>(needMore + oversample);
-
-    std::vector<uint64_t> keys(static_cast<size_t>(chainCount) + toGenerate);
-
-    // Цепочка из перестановки
-    for (int i = 1; i < size; ++i) {
-        int u = perm[i - 1];
-        int v = perm[i];
-        keys[static_cast<size_t>(i - 1)] = pack(static_cast<uint32_t>(u), static_cast<uint32_t>(v));
-    }
 
     unsigned hw = std::thread::hardware_concurrency();
     int threads = hw ? static_cast<int>(hw) : 1;
-
-    const size_t offset = static_cast<size_t>(chainCount);
     uint64_t baseSeed = r(); // базовое зерно для "расщепления"
 
-    // Параллельная генерация дополнительных ребер без петель
-    parallelFill(keys, offset, toGenerate, threads, size, baseSeed);
+    // Цепочку и случайные ребра потоки пишут прямо в сборщик, он же сортирует строки и убирает повторы.
+    // Соседи в строках по возрастанию, так что лишние ребра отрезаются с конца, как срез отсортированных ключей
+    GraphBuilder builder(size);
+    parallelAddEdges(builder, perm, static_cast<size_t>(needMore + oversample), threads, size, baseSeed, stop);
+    checkStop(stop);
+    Graph g = builder.build(numEdges);
+    checkStop(stop);
 
-    // Сортировка + дедупликация
-    std::sort(keys.begin(), keys.end());
-    size_t w = 1;
-    for (size_t i = 1; i < keys.size(); ++i) {
-        if (keys[i] != keys[i - 1]) keys[w++] = keys[i];
+    // Догенерируем пока не будет достаточно уникальных ребер
+    uint64_t extraSeed = splitmix64(baseSeed ^ 0xBF58476D1CE4E5B9ULL);
+    for (uint64_t round = 0; g.edges() < numEdges; ++round) {
+        size_t missing = static_cast<size_t>(numEdges - g.edges());
+        size_t add = missing + std::max(missing / 2, static_cast<size_t>(10000));
+        parallelAddEdges(builder, {}, add, threads, size, splitmix64(extraSeed + round), stop);
+        checkStop(stop);
+        g = builder.build(numEdges);
+        checkStop(stop);
     }
-    size_t unique = w;
+    return g;
+}
 
-    // Догенерируем пока не будет достаточно уникальных ребер
-    while (unique < static_cast<size_t>(numEdges)) {
-        size_t missing = static_cast<size_t>(numEdges) - unique;
-        size_t extra = std::max(missing / 2, static_cast<size_t>(10000));
-        size_t add = missing + extra;
+Graph RandomGraphGenerator::generateSymmetricGraph(std::mt19937_64& r, int size, int numEdges,
+                                                   const br::StopToken& stop) {
+    if (numEdges < size - 1) {
+        throw std::invalid_argument("We need min size-1 edges");
+    }
+    long long maxUndirected = 1LL * size * (size - 1) / 2;
+    if (1LL * numEdges > maxUndirected) {
+        throw std::invalid_argument("Too many edges for undirected graph without self-loops");
+    }
+
+    std::vector<int> perm(size);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), r);
 
-        std::vector<uint64_t> more(unique + add);
-        std::copy(keys.begin(), keys.begin() + unique, more.begin());
+    // Ребро {u, v} храним как (min, max), тогда дубликаты в обе стороны схлопываются одной сортировкой
+    auto normalized = [](uint64_t key) {
+        uint32_t u = unpackU(key);
+        uint32_t v = unpackV(key);
+        return u < v ? pack(u, v) : pack(v, u);
+    };
+    std::vector<uint64_t> path(static_cast<size_t>(std::max(size - 1, 0)));
+    for (int i = 1; i < size; ++i) {
+        auto u = static_cast<uint32_t>(perm[i - 1]);
+        auto v = static_cast<uint32_t>(perm[i]);
+        path[static_cast<size_t>(i - 1)] = normalized(pack(u, v));
+    }
+    std::sort(path.begin(), path.end());
 
-        uint64_t baseSeed2 = splitmix64(baseSeed ^ 0xBF58476D1CE4E5B9ULL);
-        parallelFill(more, unique, add, threads, size, baseSeed2);
+    unsigned hw = std::thread::hardware_concurrency();
+    int threads = hw ? static_cast<int>(hw) : 1;
+    const size_t needMore = static_cast<size_t>(numEdges) - path.size();
+    uint64_t baseSeed = r();
 
-        std::sort(more.begin(), more.end());
-        w = 1;
-        for (size_t i = 1; i < more.size(); ++i) {
-            if (more[i] != more[i - 1]) more[w++] = more[i];
+    // Случайные ребра отдельно от пути: лишние потом отбрасываются случайно, а не по порядку ключей,
+    // и путь, который держит граф связным, при этом не теряется
+    std::vector<uint64_t> extra;
+    size_t unique = 0;
+    for (int round = 0; unique < needMore; ++round) {
+        size_t missing = needMore - unique;
+        size_t add = missing + std::max(missing / 50, static_cast<size_t>(10000));
+        extra.resize(unique + add);
+        parallelFill(extra, unique, add, threads, size, splitmix64(baseSeed + static_cast<uint64_t>(round)), stop);
+        checkStop(stop);
+        for (size_t i = unique; i < extra.size(); ++i) {
+            extra[i] = normalized(extra[i]);
         }
-        unique = w;
-        keys.swap(more);
+        unique = sortUnique(extra, stop);
+        auto end = std::remove_if(extra.begin(), extra.begin() + static_cast<std::ptrdiff_t>(unique),
+                                  [&](uint64_t key) { return std::binary_search(path.begin(), path.end(), key); });
+        unique = static_cast<size_t>(end - extra.begin());
     }
+    extra.resize(unique);
+    std::shuffle(extra.begin(), extra.end(), r);
+    extra.resize(needMore);
 
-    Graph g(size);
-    for (int i = 0; i < numEdges; ++i) {
-        uint64_t key = keys[static_cast<size_t>(i)];
-        int u = static_cast<int>(unpackU(key));
-        int v = static_cast<int>(unpackV(key));
-        g.addEdge(u, v);
+    // Обе ориентации каждого ребра, отсортированные по (u, v) - это и есть симметричный CSR
+    std::vector<uint64_t> keys;
+    keys.reserve(2 * static_cast<size_t>(numEdges));
+    for (const auto* part : {&path, &extra}) {
+        for (uint64_t key : *part) {
+            keys.push_back(key);
+            keys.push_back(pack(unpackV(key), unpackU(key)));
+        }
     }
-    return g;
+    std::sort(keys.begin(), keys.end());
+    checkStop(stop);
+
+    br::HugeVector<int64_t> offsets(static_cast<size_t>(size) + 1, 0);
+    br::HugeVector<int> targets(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ++offsets[unpackU(keys[i]) + 1];
+        targets[i] = static_cast<int>(unpackV(keys[i]));
+    }
+    for (int v = 0; v < size; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    return Graph::fromSymmetricCsr(size, std::move(offsets), std::move(targets));
+}
+
+Graph RandomGraphGenerator::generateWeights(const Graph& g, std::mt19937_64& r, int maxWeight) {
+    if (maxWeight < 1) {
+        throw std::invalid_argument("Max edge weight must be positive");
+    }
+    const uint64_t seed = r();
+    std::vector<int> weights(static_cast<size_t>(g.edges()));
+    const int n = g.vertices();
+    unsigned hw = std::thread::hardware_concurrency();
+    int threads = hw ? static_cast<int>(hw) : 1;
+    const int chunk = (n + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            int start = t * chunk;
+            int end = std::min(n, start + chunk);
+            for (int u = start; u < end; ++u) {
+                auto row = g.neighbors(u);
+                auto base = static_cast<size_t>(g.edgeIndex(u));
+                for (size_t i = 0; i < row.size(); ++i) {
+                    auto a = static_cast<uint32_t>(std::min(u, row[i]));
+                    auto b = static_cast<uint32_t>(std::max(u, row[i]));
+                    uint64_t h = splitmix64(seed ^ pack(a, b));
+                    weights[base + i] = 1 + static_cast<int>(h % static_cast<uint64_t>(maxWeight));
+                }
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    return g.withWeights(std::move(weights));
+}
+
+size_t RandomGraphGenerator::sortUnique(std::vector<uint64_t>& keys, const br::StopToken& stop) {
+    std::sort(keys.begin(), keys.end());
+    checkStop(stop);
+    return static_cast<size_t>(std::unique(keys.begin(), keys.end()) - keys.begin());
+}
+
+void RandomGraphGenerator::checkStop(const br::StopToken& stop) {
+    if (stop.StopRequested()) throw GenerationStopped();
 }
 
 uint64_t RandomGraphGenerator::pack(uint32_t u, uint32_t v) {
@@ -106,7 +198,8 @@ void RandomGraphGenerator::parallelFill(std::vector<uint64_t>& keys,
                                         size_t count,
                                         int threads,
                                         int size,
-                                        uint64_t baseSeed) {
+                                        uint64_t baseSeed,
+                                        const br::StopToken& stop) {
     const size_t chunk = (count + static_cast<size_t>(threads) - 1) / static_cast<size_t>(threads);
     std::vector<std::thread> pool;
     pool.reserve(static_cast<size_t>(threads));
@@ -123,6 +216,7 @@ void RandomGraphGenerator::parallelFill(std::vector<uint64_t>& keys,
             std::uniform_int_distribution<int> distV(0, size - 2);
 
             for (size_t i = start; i < end; ++i) {
+                if ((i - start) % STOP_POLL_KEYS == 0 && stop.StopRequested()) return;
                 int u = distU(rnd);
                 int v = distV(rnd);
                 if (v >= u) ++v; // исключаем самопетлю
@@ -131,4 +225,59 @@ void RandomGraphGenerator::parallelFill(std::vector<uint64_t>& keys,
         });
     }
     for (auto& th : pool) th.join();
-}
\ No newline at end of file
+}
+void RandomGraphGenerator::parallelAddEdges(GraphBuilder& builder,
+                                            const std::vector<int>& chain,
+                                            size_t count,
+                                            int threads,
+                                            int size,
+                                            uint64_t baseSeed,
+                                            const br::StopToken& stop) {
+    const size_t links = chain.empty() ? 0 : chain.size() - 1;
+    if (size < 2) count = 0; // в графе из одной вершины нет ребер без самопетли
+    const size_t chainChunk = (links + static_cast<size_t>(threads) - 1) / static_cast<size_t>(threads);
+    const size_t chunk = (count + static_cast<size_t>(threads) - 1) / static_cast<size_t>(threads);
+    std::vector<std::thread> pool;
+    pool.reserve(static_cast<size_t>(threads));
+    // Ошибку сборщика поток сохраняет, а не роняет процесс: первую перебросим после join
+    std::vector<std::exception_ptr> errors(static_cast<size_t>(threads));
+
+    for (int t = 0; t < threads; ++t) {
+        auto body = [&, t] {
+            size_t chainStart = static_cast<size_t>(t) * chainChunk;
+            size_t chainEnd = std::min(links, chainStart + chainChunk);
+            for (size_t i = chainStart; i < chainEnd; ++i) {
+                builder.addEdge(chain[i], chain[i + 1]);
+            }
+
+            // Те же зерна и порядок, что в parallelFill: граф совпадает с собранным из отсортированных ключей
+            size_t start = static_cast<size_t>(t) * chunk;
+            size_t end = std::min(count, start + chunk);
+            if (start >= end) return;
+
+            uint64_t seed = splitmix64(baseSeed + 0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(t));
+            std::mt19937_64 rnd(seed);
+            std::uniform_int_distribution<int> distU(0, size - 1);
+            std::uniform_int_distribution<int> distV(0, size - 2);
+
+            for (size_t i = start; i < end; ++i) {
+                if ((i - start) % STOP_POLL_KEYS == 0 && stop.StopRequested()) return;
+                int u = distU(rnd);
+                int v = distV(rnd);
+                if (v >= u) ++v; // исключаем самопетлю
+                builder.addEdge(u, v);
+            }
+        };
+        pool.emplace_back([&errors, t, body] {
+            try {
+                body();
+            } catch (...) {
+                errors[static_cast<size_t>(t)] = std::current_exception();
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
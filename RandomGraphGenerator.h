@@ -2,12 +2,27 @@
 #include <cstddef>
 #include <cstdint>
 #include <random>
+#include <stdexcept>
 #include <vector>
 #include "Graph.h"
+#include "GraphBuilder.h"
+#include "bedrock.h"
+
+// Генерация прервана через br::StopToken: недостроенный граф не имеет смысла, поэтому исключение
+class GenerationStopped final : public std::runtime_error {
+public:
+    GenerationStopped() : std::runtime_error("Graph generation stopped") {}
+};
 
 class RandomGraphGenerator {
 public:
-    Graph generateGraph(std::mt19937_64 &r, int size, int numEdges);
+    Graph generateGraph(std::mt19937_64 &r, int size, int numEdges, const br::StopToken &stop = {});
+    // Неориентированный связный граф из numEdges ребер без петель и кратных ребер: случайный путь
+    // плюс случайные ребра, каждое записывается в CSR в обе стороны (edges() == 2 * numEdges)
+    Graph generateSymmetricGraph(std::mt19937_64 &r, int size, int numEdges, const br::StopToken &stop = {});
+    // Копия графа со случайными весами из [1, maxWeight]. Вес зависит только от пары концов,
+    // поэтому у неориентированного графа оба направления ребра получают один вес
+    Graph generateWeights(const Graph &g, std::mt19937_64 &r, int maxWeight);
 
 private:
     static uint64_t pack(uint32_t u, uint32_t v);
@@ -15,5 +30,10 @@ private:
     static uint32_t unpackV(uint64_t key);
     static uint64_t splitmix64(uint64_t x);
     static void parallelFill(std::vector<uint64_t> &keys, size_t offset, size_t count, int threads, int size,
-                             uint64_t baseSeed);
+                             uint64_t baseSeed, const br::StopToken &stop);
+    // Как parallelFill, но потоки сразу добавляют ребра в builder; заодно раскладывают цепочку chain[i] -> chain[i + 1]
+    static void parallelAddEdges(GraphBuilder &builder, const std::vector<int> &chain, size_t count, int threads,
+                                 int size, uint64_t baseSeed, const br::StopToken &stop);
+    static void checkStop(const br::StopToken &stop);
+    static size_t sortUnique(std::vector<uint64_t> &keys, const br::StopToken &stop);
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "ReplicatedGraph.h"
+#include "NeighborScan.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+
+ReplicatedGraph::ReplicatedGraph(const Graph &g, NumaTopology topology) : topology_(std::move(topology))
+{
+    if (topology_.nodes() <= 1) {
+        replicas_.push_back(g);
+        return;
+    }
+
+    // Каждую копию пишет поток, привязанный к своему узлу: страницы достаются узлу первого касания
+    const int n = g.vertices();
+    std::vector<std::optional<Graph>> built(topology_.nodes());
+    std::vector<std::thread> builders;
+    for (int node = 0; node < topology_.nodes(); ++node) {
+        builders.push_back(threadOnNode(topology_, node, [&, node] {
+            br::HugeVector<int64_t> offsets(static_cast<size_t>(n) + 1);
+            br::HugeVector<int> targets(static_cast<size_t>(g.edges()));
+            for (int v = 0; v < n; ++v) {
+                auto row = g.neighbors(v);
+                std::copy(row.begin(), row.end(), targets.begin() + g.edgeIndex(v));
+                offsets[v + 1] = g.edgeIndex(v) + static_cast<int64_t>(row.size());
+            }
+            built[node] = g.isSymmetric() ? Graph::fromSymmetricCsr(n, std::move(offsets), std::move(targets))
+                                          : Graph(n, std::move(offsets), std::move(targets));
+        }));
+    }
+    for (auto &builder : builders) {
+        builder.join();
+    }
+    for (auto &replica : built) {
+        replicas_.push_back(std::move(*replica));
+    }
+    auto bytes = static_cast<int64_t>(sizeof(int64_t) * (static_cast<size_t>(n) + 1) + sizeof(int) * g.edges());
+    overheadBytes_ = bytes * topology_.nodes();
+}
+
+int ReplicatedGraph::replicas() const
+{
+    return static_cast<int>(replicas_.size());
+}
+
+const Graph &ReplicatedGraph::replica(int node) const
+{
+    return replicas_.at(node);
+}
+
+int64_t ReplicatedGraph::overheadBytes() const
+{
+    return overheadBytes_;
+}
+
+BfsResult ReplicatedGraph::bfs(int startVertex, const br::StopToken &stop) const
+{
+    const int n = replicas_.front().vertices();
+    BfsResult result{std::vector<int>(n, -1)};
+    if (startVertex < 0 || startVertex >= n)
+        return result;
+
+    br::HugeVector<uint8_t> visited(n + VISITED_PADDING, 0);
+    visited[startVertex] = 1;
+    result.distances[startVertex] = 0;
+    br::HugeVector<int> frontier{startVertex};
+    for (int depth = 1; !frontier.empty() && !stop.StopRequested(); ++depth) {
+        frontier = expandFrontier(
+            frontier, [&](int u) { return unvisitedNeighbors(local().neighbors(u), visited.data()); },
+            [&](int, int v) {
+                uint8_t expected = 0;
+                if (!std::atomic_ref<uint8_t>(visited[v]).compare_exchange_strong(expected, 1,
+                                                                                  std::memory_order_relaxed))
+                    return false;
+                result.distances[v] = depth;
+                return true;
+            },
+            stop);
+    }
+    result.status = traversalStatus(stop);
+    return result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Graph.h"
+#include "Numa.h"
+
+// Неизменяемый граф с копией CSR в памяти каждого узла NUMA: на двухсокетной машине даже при чередовании
+// страниц половина чтений строк уходит в чужую память. Обход читает строки из реплики узла, на котором идет
+// задача пула, а visited и фронт общие для всех. На машине с одним узлом реплика одна - сам граф, без копии.
+// Входящие ребра и веса не копируются
+class ReplicatedGraph {
+public:
+    explicit ReplicatedGraph(const Graph &g, NumaTopology topology = numaTopology());
+
+    [[nodiscard]] int replicas() const;
+    [[nodiscard]] const Graph &replica(int node) const;
+    // Реплика узла, на котором сейчас идет поток
+    [[nodiscard]] const Graph &local() const
+    {
+        return replicas_[topology_.currentNode()];
+    }
+    // Сколько памяти заняли копии CSR, 0 если копировать не понадобилось
+    [[nodiscard]] int64_t overheadBytes() const;
+
+    // Параллельный BFS, как parallelTraverseBFS, но соседей каждая задача читает из своей реплики
+    [[nodiscard]] BfsResult bfs(int startVertex, const br::StopToken &stop = {}) const;
+
+private:
+    NumaTopology topology_;
+    std::vector<Graph> replicas_;
+    int64_t overheadBytes_ = 0;
+};
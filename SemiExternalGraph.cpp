@@ -0,0 +1,224 @@
+#include "SemiExternalGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+// Отрезок файла [start, end) с выровненными границами и строки фронта [first, last), которые в нем лежат
+struct Read {
+    int64_t start;
+    int64_t end;
+    size_t first;
+    size_t last;
+};
+
+struct AlignedFree {
+    void operator()(void *data) const
+    {
+        std::free(data);
+    }
+};
+
+// O_DIRECT требует выровненных адреса, позиции и длины
+std::unique_ptr<uint8_t[], AlignedFree> alignedBuffer(int64_t size)
+{
+    auto *data = static_cast<uint8_t *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, static_cast<size_t>(size)));
+    if (data == nullptr)
+        throw std::bad_alloc();
+    return std::unique_ptr<uint8_t[], AlignedFree>(data);
+}
+
+int64_t alignUp(int64_t position)
+{
+    return (position + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+}
+
+// Читает, пока не наберет size байт или не дойдет до конца файла. Возвращает прочитанное, -1 при ошибке
+// (тогда причина в errno). Короткое чтение errno не трогает: чтение с выравниванием за конец файла - норма
+int64_t readFully(int fd, void *buffer, int64_t size, int64_t position)
+{
+    int64_t done = 0;
+    while (done < size) {
+        ssize_t got = pread(fd, static_cast<uint8_t *>(buffer) + done, static_cast<size_t>(size - done),
+                            static_cast<off_t>(position + done));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        done += got;
+    }
+    return done;
+}
+} // namespace
+
+SemiExternalGraph::SemiExternalGraph(const std::string &path, unsigned ioDepth) : layout_(Graph::fileLayout(path))
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    offsets_.resize(static_cast<size_t>(layout_.vertices) + 1);
+    auto offsetBytes = static_cast<int64_t>(sizeof(int64_t) * offsets_.size());
+    if (readFully(fd, offsets_.data(), offsetBytes, layout_.offsetsPosition) != offsetBytes) {
+        close(fd);
+        throw std::runtime_error("Failed to read offsets from " + path);
+    }
+    // Смещения с диска задают, что и куда читать: проверяем их сразу, а соседей - по мере чтения строк
+    bool consistent = offsets_.front() == 0 && offsets_.back() == layout_.edges;
+    for (int v = 0; consistent && v < layout_.vertices; ++v) {
+        consistent = offsets_[v] <= offsets_[v + 1];
+    }
+    if (!consistent) {
+        close(fd);
+        throw std::runtime_error(path + " has inconsistent offsets");
+    }
+
+    // Открыть с O_DIRECT удается не везде, а где удается, чтение все равно может вернуть EINVAL: проверяем
+    int direct = open(path.c_str(), O_RDONLY | O_DIRECT);
+    if (direct >= 0) {
+        auto probe = alignedBuffer(DIRECT_IO_ALIGNMENT);
+        if (readFully(direct, probe.get(), DIRECT_IO_ALIGNMENT, 0) >= 0) {
+            close(fd);
+            fd = direct;
+            direct_ = true;
+        } else {
+            close(direct);
+        }
+    }
+    if (!direct_)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    fd_ = fd;
+    io_ = std::make_unique<br::ThreadPool>(std::max(ioDepth, 1u));
+}
+
+SemiExternalGraph::~SemiExternalGraph()
+{
+    io_.reset();
+    close(fd_);
+}
+
+int SemiExternalGraph::vertices() const
+{
+    return layout_.vertices;
+}
+
+int64_t SemiExternalGraph::edges() const
+{
+    return layout_.edges;
+}
+
+bool SemiExternalGraph::directIo() const
+{
+    return direct_;
+}
+
+ExternalBfsResult SemiExternalGraph::bfs(int startVertex, const br::StopToken &stop) const
+{
+    const int n = layout_.vertices;
+    ExternalBfsResult result{std::vector<int>(n, -1)};
+    if (startVertex < 0 || startVertex >= n)
+        return result;
+
+    br::HugeVector<uint64_t> visited((static_cast<size_t>(n) + 63) / 64, 0);
+    auto claim = [&](int v) {
+        uint64_t bit = uint64_t{1} << (v % 64);
+        return (std::atomic_ref<uint64_t>(visited[v / 64]).fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+    };
+    claim(startVertex);
+    result.distances[startVertex] = 0;
+    std::vector<int> frontier{startVertex};
+    auto rowStart = [&](int u) { return layout_.targetsPosition + static_cast<int64_t>(sizeof(int)) * offsets_[u]; };
+
+    for (int depth = 1; !frontier.empty() && !stop.StopRequested(); ++depth) {
+        // Строки CSR лежат в файле по порядку вершин: отсортированный фронт - это отсортированные позиции
+        std::sort(frontier.begin(), frontier.end());
+        std::vector<Read> reads;
+        for (size_t i = 0; i < frontier.size(); ++i) {
+            int64_t begin = rowStart(frontier[i]);
+            int64_t end = rowStart(frontier[i] + 1);
+            if (begin == end)
+                continue;
+            int64_t from = begin / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+            int64_t to = alignUp(end);
+            bool coalesce = !reads.empty() && from <= reads.back().end + COALESCE_GAP &&
+                            to - reads.back().start <= MAX_READ_BYTES;
+            if (coalesce) {
+                reads.back().end = std::max(reads.back().end, to);
+                reads.back().last = i + 1;
+            } else {
+                reads.push_back({from, to, i, i + 1});
+            }
+            result.rowBytes += end - begin;
+        }
+
+        std::vector<std::vector<int>> found(reads.size());
+        std::atomic<int> error = 0;
+        std::atomic<bool> corrupted = false;
+        // Пул не ловит исключения задач: нехватку памяти задача сохраняет сюда, а после Wait она перебрасывается
+        std::vector<std::exception_ptr> failures(reads.size());
+        br::WaitGroup wg(reads.size());
+        for (size_t k = 0; k < reads.size(); ++k) {
+            io_->Push([&, k] {
+                const Read &read = reads[k];
+                try {
+                    if (!stop.StopRequested()) {
+                        auto buffer = alignedBuffer(read.end - read.start);
+                        int64_t needed = rowStart(frontier[read.last - 1] + 1) - read.start;
+                        int64_t got = readFully(fd_, buffer.get(), read.end - read.start, read.start);
+                        if (got < needed) {
+                            // Короткое чтение - файл короче, чем обещают смещения, errno оно не выставляет
+                            error = got < 0 ? errno : EIO;
+                        } else {
+                            for (size_t i = read.first; i < read.last; ++i) {
+                                int u = frontier[i];
+                                const auto *row =
+                                    reinterpret_cast<const int *>(buffer.get() + (rowStart(u) - read.start));
+                                for (int64_t e = 0; e < offsets_[u + 1] - offsets_[u]; ++e) {
+                                    int v = row[e];
+                                    if (v < 0 || v >= n) {
+                                        corrupted = true;
+                                        continue;
+                                    }
+                                    if (claim(v)) {
+                                        result.distances[v] = depth;
+                                        found[k].push_back(v);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                } catch (...) {
+                    failures[k] = std::current_exception();
+                }
+                wg.Done();
+            });
+            result.bytesRead += reads[k].end - reads[k].start;
+        }
+        result.reads += static_cast<int64_t>(reads.size());
+        wg.Wait();
+        for (auto &failure : failures) {
+            if (failure)
+                std::rethrow_exception(failure);
+        }
+        if (error != 0)
+            throw std::runtime_error(std::string("Failed to read neighbor rows: ") + std::strerror(error));
+        if (corrupted)
+            throw std::runtime_error("Graph file has a neighbor out of vertex range");
+
+        frontier.clear();
+        for (auto &part : found) {
+            frontier.insert(frontier.end(), part.begin(), part.end());
+        }
+    }
+    result.status = traversalStatus(stop);
+    return result;
+}
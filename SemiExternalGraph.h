@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Graph.h"
+#include "bedrock.h"
+
+constexpr int64_t DIRECT_IO_ALIGNMENT = 4096;
+constexpr int64_t COALESCE_GAP = 64 * 1024;          // дыру меньше этой дешевле дочитать, чем делать отдельный запрос
+constexpr int64_t MAX_READ_BYTES = 1024 * 1024;      // больше в один запрос не склеиваем, длинная строка идет целиком
+constexpr unsigned DEFAULT_IO_DEPTH = 32;            // одновременных pread
+
+struct ExternalBfsResult {
+    std::vector<int> distances; // -1 для недостижимых
+    TraversalStatus status = TraversalStatus::COMPLETED;
+    int64_t reads = 0;     // запросов к диску
+    int64_t bytesRead = 0; // прочитано вместе с выравниванием и дырами
+    int64_t rowBytes = 0;  // из них строки соседей фронта
+};
+
+// Полувнешний граф: смещения (8 байт на вершину) и visited в памяти, строки соседей - в файле Graph::save.
+// Каждый уровень BFS сортирует строки фронта по позиции в файле, склеивает соседние в запросы
+// до MAX_READ_BYTES и отдает их отдельному пулу из ioDepth потоков с pread. Поток, дождавшийся своих данных,
+// сразу разбирает строки, пока остальные запросы еще читаются. Файл открывается с O_DIRECT, чтобы не
+// засорять и не использовать страничный кэш; если файловая система его не умеет (tmpfs), читаем обычным pread.
+// Смещения проверяются при открытии, соседи - по мере чтения: испорченный файл дает std::runtime_error
+class SemiExternalGraph {
+public:
+    explicit SemiExternalGraph(const std::string &path, unsigned ioDepth = DEFAULT_IO_DEPTH);
+    ~SemiExternalGraph();
+
+    SemiExternalGraph(const SemiExternalGraph &) = delete;
+    SemiExternalGraph &operator=(const SemiExternalGraph &) = delete;
+
+    [[nodiscard]] int vertices() const;
+    [[nodiscard]] int64_t edges() const;
+    [[nodiscard]] bool directIo() const;
+
+    [[nodiscard]] ExternalBfsResult bfs(int startVertex, const br::StopToken &stop = {}) const;
+
+private:
+    int fd_ = -1;
+    bool direct_ = false;
+    Graph::FileLayout layout_;
+    br::HugeVector<int64_t> offsets_;
+    std::unique_ptr<br::ThreadPool> io_;
+};
@@ -0,0 +1,319 @@
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Graph.h"
+#include "Protocol.h"
+#include "QueryEngine.h"
+#include "RandomGraphGenerator.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Долгоживущий процесс с графом: принимает запросы по Unix-сокету и склеивает те,
+// что пришли в пределах окна, в один пакет для QueryEngine::answer.
+// Сегмент --publish принадлежит опубликовавшему серверу: он удаляет его при остановке по SIGINT/SIGTERM
+// или по ошибке. Сегмент, оставшийся после аварийного завершения, удаляет server --unlink <segment>
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+struct Options {
+    std::string socketPath;
+    std::string loadPath;
+    std::string attachName; // сегмент shared memory, опубликованный другим процессом
+    std::string savePath;
+    std::string publishName; // удаляется при остановке сервера
+    int vertices = 0;
+    int edges = 0;
+    std::chrono::microseconds window{200};
+    size_t maxBatch = 4096;
+};
+
+// Ответы, которые клиент не успевает читать, копятся в output. Сокет неблокирующий: один медленный клиент
+// не должен останавливать цикл событий для остальных, а его очередь ограничена MAX_OUTPUT_BACKLOG
+struct Client {
+    int fd;
+    std::string input;
+    std::string output;
+};
+
+static constexpr size_t MAX_OUTPUT_BACKLOG = 4 * 1024 * 1024;
+
+struct Pending {
+    uint64_t client;
+    proto::Request request;
+};
+
+static void usage()
+{
+    std::cerr << "Usage: server <socket-path> (--load <graph-file> | --attach <segment> |\n"
+                 "                             --generate <vertices> <edges>) [--save <graph-file>]\n"
+                 "              [--publish <segment>] [--window-us <microseconds>] [--max-batch <requests>]\n"
+                 "       server --unlink <segment>\n";
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    if (argc < 2)
+        return false;
+    options.socketPath = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto hasValues = [&](int count) { return i + count < argc; };
+        if (arg == "--load" && hasValues(1)) {
+            options.loadPath = argv[++i];
+        } else if (arg == "--attach" && hasValues(1)) {
+            options.attachName = argv[++i];
+        } else if (arg == "--generate" && hasValues(2)) {
+            options.vertices = std::stoi(argv[++i]);
+            options.edges = std::stoi(argv[++i]);
+        } else if (arg == "--save" && hasValues(1)) {
+            options.savePath = argv[++i];
+        } else if (arg == "--publish" && hasValues(1)) {
+            options.publishName = argv[++i];
+        } else if (arg == "--window-us" && hasValues(1)) {
+            options.window = std::chrono::microseconds(std::stoll(argv[++i]));
+        } else if (arg == "--max-batch" && hasValues(1)) {
+            options.maxBatch = std::stoull(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return !options.loadPath.empty() + !options.attachName.empty() + (options.vertices != 0) == 1;
+}
+
+// Отправляет сколько примет сокет; false, если соединение разорвано
+static bool flushOutput(Client &client)
+{
+    size_t sent = 0;
+    while (sent < client.output.size()) {
+        ssize_t written = send(client.fd, client.output.data() + sent, client.output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (written <= 0)
+            return false;
+        sent += static_cast<size_t>(written);
+    }
+    client.output.erase(0, sent);
+    return true;
+}
+
+static void dropClient(std::unordered_map<uint64_t, Client> &clients, uint64_t id)
+{
+    close(clients.at(id).fd);
+    clients.erase(id);
+}
+
+static int listenOn(const std::string &path)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("Socket path is too long: " + path);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to listen on " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+static void answerBatch(const Graph &g, QueryEngine &engine, std::vector<Pending> &batch,
+                        std::unordered_map<uint64_t, Client> &clients)
+{
+    auto isVertex = [&](int32_t v) { return v >= 0 && v < g.vertices(); };
+    std::vector<QueryEngine::PointQuery> queries;
+    std::vector<size_t> queryOf(batch.size(), SIZE_MAX); // SIZE_MAX - запрос не уходит в движок
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const auto &r = batch[i].request;
+        bool valid = isVertex(r.source) &&
+                     ((r.kind == proto::Kind::K_HOP && r.argument >= 0) ||
+                      ((r.kind == proto::Kind::REACHABLE || r.kind == proto::Kind::DISTANCE) && isVertex(r.argument)));
+        if (valid) {
+            queryOf[i] = queries.size();
+            queries.push_back({static_cast<QueryEngine::PointQuery::Kind>(r.kind), r.source, r.argument});
+        }
+    }
+    auto answers = engine.answer(queries);
+
+    std::unordered_map<uint64_t, std::vector<proto::Response>> replies;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const auto &r = batch[i].request;
+        proto::Response response{r.id, proto::Status::OK, 0};
+        if (r.kind == proto::Kind::INFO) {
+            response.value = g.vertices();
+        } else if (queryOf[i] == SIZE_MAX) {
+            response.status = proto::Status::BAD_REQUEST;
+        } else {
+            response.value = answers[queryOf[i]];
+        }
+        replies[batch[i].client].push_back(response);
+    }
+
+    for (auto &[id, responses] : replies) {
+        auto it = clients.find(id);
+        if (it == clients.end())
+            continue; // клиент отключился, пока пакет считался
+        auto &client = it->second;
+        client.output.append(reinterpret_cast<const char *>(responses.data()),
+                             responses.size() * sizeof(proto::Response));
+        if (!flushOutput(client) || client.output.size() > MAX_OUTPUT_BACKLOG)
+            dropClient(clients, id);
+    }
+    batch.clear();
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    bool published = false;
+    // SIGINT/SIGTERM заблокированы во всех потоках (пулы наследуют маску) и доходят только внутри ppoll,
+    // который атомарно ставит прежнюю маску: сигнал между проверкой stopRequested и ppoll не теряется
+    sigset_t stopSignals;
+    sigset_t waitMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &waitMask);
+    sigdelset(&waitMask, SIGINT);
+    sigdelset(&waitMask, SIGTERM);
+    try {
+        if (argc == 3 && std::string(argv[1]) == "--unlink") {
+            Graph::unlinkShared(argv[2]);
+            return 0;
+        }
+        if (!parseOptions(argc, argv, options)) {
+            usage();
+            return 1;
+        }
+
+        Graph g = [&] {
+            if (!options.loadPath.empty()) {
+                std::cout << "Mapping graph " << options.loadPath << " ... wait\n";
+                return Graph::load(options.loadPath);
+            }
+            if (!options.attachName.empty()) {
+                std::cout << "Attaching shared graph " << options.attachName << '\n';
+                return Graph::attachShared(options.attachName);
+            }
+            std::cout << "Generating graph of size " << options.vertices << " ... wait\n";
+            std::mt19937_64 r(42);
+            return RandomGraphGenerator().generateGraph(r, options.vertices, options.edges);
+        }();
+        if (!options.savePath.empty())
+            g.save(options.savePath);
+        if (!options.publishName.empty()) {
+            g.publishShared(options.publishName);
+            published = true;
+        }
+        std::cout << "Graph ready: " << g.vertices() << " vertices, " << g.edges() << " edges\n";
+
+        QueryEngine engine(g);
+        int listener = listenOn(options.socketPath);
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::cout << "Listening on " << options.socketPath << '\n';
+
+        std::unordered_map<uint64_t, Client> clients;
+        uint64_t nextClient = 0;
+        std::vector<Pending> batch;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+
+        while (!stopRequested) {
+            std::vector<pollfd> fds{{listener, POLLIN, 0}};
+            std::vector<uint64_t> ids{0};
+            for (auto &[id, client] : clients) {
+                auto events = static_cast<short>(POLLIN | (client.output.empty() ? 0 : POLLOUT));
+                fds.push_back({client.fd, events, 0});
+                ids.push_back(id);
+            }
+
+            timespec timeout{};
+            timespec *timeoutPtr = nullptr;
+            if (!batch.empty()) {
+                auto left = std::max(deadline - std::chrono::steady_clock::now(), std::chrono::nanoseconds::zero());
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+                timeout.tv_sec = ns / 1000000000;
+                timeout.tv_nsec = ns % 1000000000;
+                timeoutPtr = &timeout;
+            }
+            int ready = ppoll(fds.data(), fds.size(), timeoutPtr, &waitMask);
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("ppoll: ") + std::strerror(errno));
+
+            for (size_t i = 1; ready > 0 && i < fds.size(); ++i) {
+                auto &client = clients.at(ids[i]);
+                if ((fds[i].revents & POLLOUT) && !flushOutput(client)) {
+                    dropClient(clients, ids[i]);
+                    continue;
+                }
+                if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+                    continue;
+                char buffer[64 * 1024];
+                ssize_t got = read(client.fd, buffer, sizeof(buffer));
+                if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                    continue;
+                if (got <= 0) {
+                    dropClient(clients, ids[i]);
+                    continue;
+                }
+                client.input.append(buffer, static_cast<size_t>(got));
+                size_t whole = client.input.size() / sizeof(proto::Request);
+                for (size_t k = 0; k < whole; ++k) {
+                    Pending pending{ids[i], {}};
+                    std::memcpy(&pending.request, client.input.data() + k * sizeof(proto::Request),
+                                sizeof(proto::Request));
+                    if (batch.empty())
+                        deadline = std::chrono::steady_clock::now() + options.window;
+                    batch.push_back(pending);
+                }
+                client.input.erase(0, whole * sizeof(proto::Request));
+            }
+
+            if (ready > 0 && (fds[0].revents & POLLIN)) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd >= 0)
+                    clients.emplace(++nextClient, Client{fd, {}, {}});
+            }
+
+            if (!batch.empty() && (batch.size() >= options.maxBatch || std::chrono::steady_clock::now() >= deadline))
+                answerBatch(g, engine, batch, clients);
+        }
+
+        for (auto &[id, client] : clients) {
+            close(client.fd);
+        }
+        close(listener);
+        unlink(options.socketPath.c_str());
+        if (published)
+            Graph::unlinkShared(options.publishName);
+        std::cout << "Stopped\n";
+    } catch (const std::exception &ex) {
+        std::cerr << "Exception: " << ex.what() << "\n";
+        try {
+            if (published)
+                Graph::unlinkShared(options.publishName);
+        } catch (const std::exception &cleanup) {
+            std::cerr << "Exception: " << cleanup.what() << "\n";
+        }
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "ShortestPaths.h"
+#include "Parallel.h"
+#include "Traversal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace {
+constexpr int64_t UNREACHED = std::numeric_limits<int64_t>::max();
+
+// Атомарный минимум, true если значение уменьшилось
+bool atomicMin(int64_t &target, int64_t value)
+{
+    std::atomic_ref<int64_t> ref(target);
+    int64_t current = ref.load(std::memory_order_relaxed);
+    while (value < current) {
+        if (ref.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+} // namespace
+
+SsspResult ShortestPaths::deltaStepping(const Graph &g, int source, int64_t delta, const br::StopToken &stop)
+{
+    const int n = g.vertices();
+    if (source < 0 || source >= n)
+        return {std::vector<int64_t>(n, -1), TraversalStatus::COMPLETED};
+    if (!g.hasWeights())
+        return scaledBfs(g, source, 1, stop);
+    if (int64_t weight = uniformWeight(g); weight >= 0)
+        return scaledBfs(g, source, weight, stop);
+
+    // Средний вес нужен для delta по умолчанию, наибольший - для размера кольца корзин
+    std::atomic<int64_t> total = 0;
+    std::atomic<int64_t> maxWeight = 0;
+    parallelFor(0, n, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        int64_t local = 0;
+        int64_t localMax = 0;
+        for (size_t u = chunkStart; u < chunkEnd; ++u) {
+            for (int w : g.edgeWeights(static_cast<int>(u))) {
+                local += w;
+                localMax = std::max<int64_t>(localMax, w);
+            }
+        }
+        total.fetch_add(local, std::memory_order_relaxed);
+        int64_t current = maxWeight.load(std::memory_order_relaxed);
+        while (localMax > current && !maxWeight.compare_exchange_weak(current, localMax, std::memory_order_relaxed)) {
+        }
+    });
+    if (delta <= 0)
+        delta = std::max<int64_t>(1, total.load(std::memory_order_relaxed) / std::max<int64_t>(1, g.edges()));
+
+    std::vector<int64_t> dist(n, UNREACHED);
+    dist[source] = 0;
+    // Вершина текущей корзины b лежит в [b * delta, (b + 1) * delta), поэтому ребро ведет не дальше корзины
+    // b + maxWeight / delta + 1: живых корзин не больше ring, и корзина b хранится в ячейке b % ring.
+    // Кольца у каждого куска parallelFor свои: номер куска меньше threadCount() и в одном вызове
+    // обрабатывается одной задачей, так что запись в них не синхронизируется
+    const auto ring = static_cast<size_t>(maxWeight.load(std::memory_order_relaxed) / delta) + 2;
+    std::vector<std::vector<std::vector<int>>> bins(threadCount(), std::vector<std::vector<int>>(ring));
+    std::vector<int> frontier{source};
+    size_t bucket = 0;
+    while (!frontier.empty() && !stop.StopRequested()) {
+        const int64_t bucketStart = static_cast<int64_t>(bucket) * delta;
+        parallelFor(0, frontier.size(), [&](size_t chunkStart, size_t chunkEnd, size_t chunk) {
+            auto &local = bins[chunk];
+            for (size_t i = chunkStart; i < chunkEnd; ++i) {
+                if ((i - chunkStart) % STOP_POLL_INTERVAL == 0 && stop.StopRequested())
+                    break;
+                int u = frontier[i];
+                int64_t du = std::atomic_ref<int64_t>(dist[u]).load(std::memory_order_relaxed);
+                // Устаревшая запись: вершина уже улучшена и обработана в более ранней корзине
+                if (du < bucketStart)
+                    continue;
+                auto row = g.neighbors(u);
+                auto weights = g.edgeWeights(u);
+                for (size_t k = 0; k < row.size(); ++k) {
+                    int64_t candidate = du + weights[k];
+                    if (atomicMin(dist[row[k]], candidate))
+                        local[static_cast<size_t>(candidate / delta) % ring].push_back(row[k]);
+                }
+            }
+        });
+
+        // Легкие ребра могли вернуть вершины в текущую корзину - тогда она обрабатывается еще раз.
+        // За пределами кольца непустых корзин нет
+        size_t next = std::numeric_limits<size_t>::max();
+        for (size_t b = bucket; b < bucket + ring && next == std::numeric_limits<size_t>::max(); ++b) {
+            for (auto &local : bins) {
+                if (!local[b % ring].empty()) {
+                    next = b;
+                    break;
+                }
+            }
+        }
+        frontier.clear();
+        if (next == std::numeric_limits<size_t>::max())
+            break;
+        for (auto &local : bins) {
+            auto &slot = local[next % ring];
+            frontier.insert(frontier.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+        bucket = next;
+    }
+
+    SsspResult result{std::vector<int64_t>(n), traversalStatus(stop)};
+    for (int v = 0; v < n; ++v) {
+        result.distances[v] = dist[v] == UNREACHED ? -1 : dist[v];
+    }
+    return result;
+}
+
+SsspResult ShortestPaths::scaledBfs(const Graph &g, int source, int64_t weight, const br::StopToken &stop)
+{
+    std::vector<int> depth(g.vertices(), -1);
+    TraversalStatus status = parallelTraverseBFS(g, source, DistanceVisitor{depth}, stop);
+    SsspResult result{std::vector<int64_t>(g.vertices()), status};
+    for (int v = 0; v < g.vertices(); ++v) {
+        result.distances[v] = depth[v] < 0 ? -1 : depth[v] * weight;
+    }
+    return result;
+}
+
+int64_t ShortestPaths::uniformWeight(const Graph &g)
+{
+    if (g.edges() == 0)
+        return 1;
+    int first = -1;
+    for (int u = 0; u < g.vertices() && first < 0; ++u) {
+        if (!g.edgeWeights(u).empty())
+            first = g.edgeWeights(u).front();
+    }
+    std::atomic<bool> uniform = true;
+    parallelFor(0, g.vertices(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t u = chunkStart; u < chunkEnd && uniform.load(std::memory_order_relaxed); ++u) {
+            for (int w : g.edgeWeights(static_cast<int>(u))) {
+                if (w != first) {
+                    uniform.store(false, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+    });
+    return uniform.load(std::memory_order_relaxed) ? first : -1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Graph.h"
+
+// Кратчайшие пути от источника, -1 для недостижимых. При остановке по токену расстояния - верхние оценки
+struct SsspResult {
+    std::vector<int64_t> distances;
+    TraversalStatus status = TraversalStatus::COMPLETED;
+};
+
+class ShortestPaths {
+public:
+    // Параллельный delta-stepping: вершины раскладываются по корзинам ширины delta, корзины обрабатываются
+    // по возрастанию, внутри корзины ребра релаксируются параллельно до опустошения. Деления на легкие
+    // и тяжелые ребра нет: все ребра релаксируются как легкие, при delta, равном среднему весу, повторная
+    // обработка вершины в той же корзине редка, а второй проход по строкам за тяжелыми ребрами дороже.
+    // Корзины хранятся кольцом из maxWeight / delta + 2 ячеек: память не растет с расстояниями.
+    // delta = 0 - средний вес.
+    // Граф без весов или с одинаковыми весами сводится к BFS: расстояние - глубина, умноженная на вес
+    SsspResult deltaStepping(const Graph &g, int source, int64_t delta = 0, const br::StopToken &stop = {});
+
+private:
+    static SsspResult scaledBfs(const Graph &g, int source, int64_t weight, const br::StopToken &stop);
+    // Общий вес всех ребер, если он один, иначе -1
+    static int64_t uniformWeight(const Graph &g);
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <atomic>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "Graph.h"
+#include "NeighborScan.h"
+#include "Parallel.h"
+#include "Prefetch.h"
+
+// BFS-ядра, параметризованные визитором. Любой хук визитора необязателен: его наличие проверяется
+// через if constexpr, так что неиспользуемые хуки не оставляют в цикле ни вызова, ни проверки.
+//   discover(vertex, parent, depth)  - вершина впервые достигнута (у стартовой parent = -1)
+//   examineEdge(u, v)                - просмотрено ребро u -> v, независимо от того, посещена ли v
+//   finishLevel(depth, level)        - уровень depth полностью обработан, level - его вершины
+// В параллельном ядре хуки зовутся из задач пула одновременно: discover - ровно один раз на вершину
+// из потока, который ее захватил, examineEdge - без всякой синхронизации, finishLevel - из вызывающего потока.
+// Без examineEdge строки соседей предварительно фильтруются векторным scanUnvisited
+
+template <typename V>
+concept BfsVisitor = std::is_class_v<std::remove_reference_t<V>>;
+
+template <typename V>
+concept DiscoverHook = requires(V &visitor, int vertex, int parent, int depth) {
+    visitor.discover(vertex, parent, depth);
+};
+
+template <typename V>
+concept ExamineEdgeHook = requires(V &visitor, int u, int v) { visitor.examineEdge(u, v); };
+
+template <typename V>
+concept FinishLevelHook = requires(V &visitor, int depth, std::span<const int> level) {
+    visitor.finishLevel(depth, level);
+};
+
+struct NoVisitor {};
+
+struct DistanceVisitor {
+    std::vector<int> &distance; // заполнен -1 до обхода
+
+    void discover(int vertex, int, int depth)
+    {
+        distance[vertex] = depth;
+    }
+};
+
+struct ParentVisitor {
+    std::vector<int> &parent; // заполнен -1 до обхода
+
+    void discover(int vertex, int from, int)
+    {
+        parent[vertex] = from;
+    }
+};
+
+// Хуку examineEdge нужны все ребра, иначе достаточно соседей, непосещенных на момент просмотра строки
+template <typename V>
+std::span<const int> candidateNeighbors(const Graph &g, int u, const uint8_t *visited)
+{
+    if constexpr (ExamineEdgeHook<V>)
+        return g.neighbors(u);
+    else
+        return unvisitedNeighbors(g.neighbors(u), visited);
+}
+
+// Трехступенчатый конвейер по очереди обхода: для вершины на 2 * row вперед тянем смещение строки,
+// на row вперед (смещение уже в кэше) - начало строки соседей, на visited вперед (строка уже в кэше) - байты
+// visited первых соседей. Длинные строки целиком не тянем: там задержку прячет сам векторный скан
+template <typename T>
+class QueuePrefetcher {
+public:
+    static constexpr size_t MAX_VISITED_PREFETCH = 16;
+
+    QueuePrefetcher(const Graph &g, const T *visited)
+        : g_(g), visited_(visited), distances_(prefetchDistances())
+    {
+    }
+
+    void operator()(std::span<const int> queue, size_t i) const
+    {
+        if (distances_.row != 0) {
+            if (i + 2 * distances_.row < queue.size())
+                g_.prefetchOffsets(queue[i + 2 * distances_.row]);
+            if (i + distances_.row < queue.size())
+                g_.prefetchNeighbors(queue[i + distances_.row]);
+        }
+        if (distances_.visited != 0 && i + distances_.visited < queue.size()) {
+            auto row = g_.neighbors(queue[i + distances_.visited]);
+            for (size_t k = 0; k < row.size() && k < MAX_VISITED_PREFETCH; ++k) {
+                __builtin_prefetch(visited_ + row[k]);
+            }
+        }
+    }
+
+private:
+    const Graph &g_;
+    const T *visited_;
+    PrefetchDistances distances_;
+};
+
+template <BfsVisitor Visitor>
+TraversalStatus traverseBFS(const Graph &g, int startVertex, Visitor &&visitor, const br::StopToken &stop = {})
+{
+    using V = std::remove_reference_t<Visitor>;
+    if (startVertex < 0 || startVertex >= g.vertices())
+        return TraversalStatus::COMPLETED;
+
+    // Каждая вершина попадает в очередь не больше раза, поэтому очередь - один плоский массив на V
+    // без роста и кольца, а уровень - просто отрезок [levelStart, levelEnd) между головой и хвостом.
+    // Проверка visited и постановка в очередь - один шаг, глубина известна из номера уровня
+    br::HugeVector<uint8_t> visited(g.vertices() + VISITED_PADDING, 0);
+    br::HugeVector<int> queue(g.vertices());
+    size_t tail = 0;
+    visited[startVertex] = 1;
+    queue[tail++] = startVertex;
+    if constexpr (DiscoverHook<V>)
+        visitor.discover(startVertex, -1, 0);
+
+    QueuePrefetcher prefetch(g, visited.data());
+    size_t head = 0;
+    for (int depth = 0; head < tail; ++depth) {
+        size_t levelStart = head;
+        size_t levelEnd = tail;
+        for (; head < levelEnd; ++head) {
+            if (head % STOP_POLL_INTERVAL == 0 && stop.StopRequested())
+                return traversalStatus(stop);
+            prefetch(std::span<const int>(queue.data(), tail), head);
+            int u = queue[head];
+            for (int v : candidateNeighbors<V>(g, u, visited.data())) {
+                if constexpr (ExamineEdgeHook<V>)
+                    visitor.examineEdge(u, v);
+                if (!visited[v]) {
+                    visited[v] = 1;
+                    queue[tail++] = v;
+                    if constexpr (DiscoverHook<V>)
+                        visitor.discover(v, u, depth + 1);
+                }
+            }
+        }
+        if constexpr (FinishLevelHook<V>)
+            visitor.finishLevel(depth, std::span<const int>(queue.data() + levelStart, levelEnd - levelStart));
+    }
+    return TraversalStatus::COMPLETED;
+}
+
+template <BfsVisitor Visitor>
+TraversalStatus parallelTraverseBFS(const Graph &g, int startVertex, Visitor &&visitor,
+                                    const br::StopToken &stop = {})
+{
+    using V = std::remove_reference_t<Visitor>;
+    if (startVertex < 0 || startVertex >= g.vertices())
+        return TraversalStatus::COMPLETED;
+
+    // Плотные байты, а не по линии кэша на вершину: их читает gather, а захват идет через atomic_ref
+    br::HugeVector<uint8_t> visited(g.vertices() + VISITED_PADDING, 0);
+
+    br::HugeVector<int> currentLevel;
+    currentLevel.push_back(startVertex);
+    visited[startVertex] = 1;
+    QueuePrefetcher prefetch(g, visited.data());
+    if constexpr (DiscoverHook<V>)
+        visitor.discover(startVertex, -1, 0);
+
+    for (int depth = 0; !currentLevel.empty(); ++depth) {
+        if (stop.StopRequested())
+            return traversalStatus(stop);
+        auto nextLevel = expandFrontier(
+            currentLevel, [&](int u) { return candidateNeighbors<V>(g, u, visited.data()); },
+            [&](int u, int v) {
+                if constexpr (ExamineEdgeHook<V>)
+                    visitor.examineEdge(u, v);
+                uint8_t expected = 0;
+                if (!std::atomic_ref<uint8_t>(visited[v]).compare_exchange_strong(expected, 1,
+                                                                                  std::memory_order_relaxed))
+                    return false;
+                if constexpr (DiscoverHook<V>)
+                    visitor.discover(v, u, depth + 1);
+                return true;
+            },
+            stop, prefetch);
+        if constexpr (FinishLevelHook<V>) {
+            if (!stop.StopRequested())
+                visitor.finishLevel(depth, std::span<const int>(currentLevel));
+        }
+        currentLevel = std::move(nextLevel);
+    }
+    // Оборванный по токену уровень мог вернуть пустой фронт, поэтому проверяем еще раз
+    return traversalStatus(stop);
+}
@@ -0,0 +1,203 @@
+#include "VersionedGraph.h"
+#include "NeighborScan.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+VersionedGraph::Snapshot::Snapshot(br::EpochDomain::Guard guard, const Version *version)
+    : guard_(std::move(guard)), version_(version)
+{
+}
+
+uint64_t VersionedGraph::Snapshot::version() const
+{
+    return version_->number;
+}
+
+int VersionedGraph::Snapshot::vertices() const
+{
+    return version_->base.vertices();
+}
+
+int64_t VersionedGraph::Snapshot::edges() const
+{
+    return version_->edges;
+}
+
+BfsResult VersionedGraph::Snapshot::bfs(int startVertex, const br::StopToken &stop) const
+{
+    const int n = vertices();
+    BfsResult result{std::vector<int>(n, -1)};
+    if (startVertex < 0 || startVertex >= n)
+        return result;
+
+    br::HugeVector<uint8_t> visited(n + VISITED_PADDING, 0);
+    visited[startVertex] = 1;
+    result.distances[startVertex] = 0;
+    br::HugeVector<int> frontier{startVertex};
+    for (int depth = 1; !frontier.empty() && !stop.StopRequested(); ++depth) {
+        frontier = expandFrontier(
+            frontier, [&](int u) { return unvisitedNeighbors(neighbors(u), visited.data()); },
+            [&](int, int v) {
+                uint8_t expected = 0;
+                if (!std::atomic_ref<uint8_t>(visited[v]).compare_exchange_strong(expected, 1,
+                                                                                  std::memory_order_relaxed))
+                    return false;
+                result.distances[v] = depth;
+                return true;
+            },
+            stop);
+    }
+    result.status = traversalStatus(stop);
+    return result;
+}
+
+VersionedGraph::VersionedGraph(Graph base)
+{
+    const int blocks = (base.vertices() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int64_t edges = base.edges();
+    current_.store(new Version{1, std::move(base), std::vector<std::shared_ptr<const Block>>(blocks), edges, 0});
+}
+
+VersionedGraph::~VersionedGraph()
+{
+    delete current_.load(std::memory_order_relaxed);
+}
+
+VersionedGraph::Snapshot VersionedGraph::snapshot() const
+{
+    auto guard = epochs_.Pin();
+    return Snapshot(std::move(guard), current_.load(std::memory_order_seq_cst));
+}
+
+uint64_t VersionedGraph::apply(std::span<const EdgeUpdate> batch)
+{
+    std::lock_guard lock(writer_);
+    const Version *old = current_.load(std::memory_order_relaxed); // пишет только владелец writer_
+    const int n = old->base.vertices();
+
+    std::vector<EdgeUpdate> updates;
+    updates.reserve(batch.size());
+    for (const auto &e : batch) {
+        if (e.src >= 0 && e.src < n && e.dest >= 0 && e.dest < n)
+            updates.push_back(e);
+    }
+    std::stable_sort(updates.begin(), updates.end(),
+                     [](const EdgeUpdate &a, const EdgeUpdate &b) { return a.src < b.src; });
+    // Начала блоков в отсортированном пакете: каждый задетый блок пересобирается одной задачей
+    std::vector<size_t> starts;
+    for (size_t k = 0; k < updates.size(); ++k) {
+        if (k == 0 || updates[k].src / BLOCK_SIZE != updates[k - 1].src / BLOCK_SIZE)
+            starts.push_back(k);
+    }
+    starts.push_back(updates.size());
+
+    auto next = std::make_unique<Version>(Version{old->number + 1, old->base, old->blocks, old->edges,
+                                                  old->blockEdges});
+    std::atomic<int64_t> edgeChange = 0;
+    std::atomic<int64_t> blockEdgeChange = 0;
+    parallelFor(0, starts.size() - 1, [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        std::vector<int> row;
+        for (size_t group = chunkStart; group < chunkEnd; ++group) {
+            const int block = updates[starts[group]].src / BLOCK_SIZE;
+            const int first = block * BLOCK_SIZE;
+            const int last = std::min(n, first + BLOCK_SIZE);
+            const Block *previous = old->blocks[block].get();
+            auto rowOf = [&](int v) {
+                if (previous == nullptr)
+                    return old->base.neighbors(v);
+                int i = v - first;
+                return std::span<const int>(previous->targets)
+                    .subspan(previous->offsets[i], previous->offsets[i + 1] - previous->offsets[i]);
+            };
+
+            auto fresh = std::make_shared<Block>();
+            fresh->offsets.reserve(static_cast<size_t>(last - first) + 1);
+            fresh->offsets.push_back(0);
+            size_t k = starts[group];
+            for (int v = first; v < last; ++v) {
+                auto current = rowOf(v);
+                if (k == starts[group + 1] || updates[k].src != v) {
+                    fresh->targets.insert(fresh->targets.end(), current.begin(), current.end());
+                } else {
+                    row.assign(current.begin(), current.end());
+                    for (; k < starts[group + 1] && updates[k].src == v; ++k) {
+                        auto it = std::find(row.begin(), row.end(), updates[k].dest);
+                        if (updates[k].kind == EdgeUpdate::Kind::INSERT && it == row.end()) {
+                            row.push_back(updates[k].dest);
+                            edgeChange.fetch_add(1, std::memory_order_relaxed);
+                        } else if (updates[k].kind == EdgeUpdate::Kind::REMOVE && it != row.end()) {
+                            row.erase(it);
+                            edgeChange.fetch_sub(1, std::memory_order_relaxed);
+                        }
+                    }
+                    fresh->targets.insert(fresh->targets.end(), row.begin(), row.end());
+                }
+                fresh->offsets.push_back(static_cast<int64_t>(fresh->targets.size()));
+            }
+            auto previousEdges = previous == nullptr ? 0 : static_cast<int64_t>(previous->targets.size());
+            blockEdgeChange.fetch_add(static_cast<int64_t>(fresh->targets.size()) - previousEdges,
+                                      std::memory_order_relaxed);
+            next->blocks[block] = std::move(fresh); // у каждого блока одна задача
+        }
+    });
+    next->edges += edgeChange.load(std::memory_order_relaxed);
+    next->blockEdges += blockEdgeChange.load(std::memory_order_relaxed);
+    if (next->blockEdges > next->base.edges() / FOLD_FRACTION)
+        next = fold(*next);
+
+    // Публикация, затем отложенное удаление: снимки старой версии дочитают ее спокойно
+    uint64_t number = next->number;
+    const Version *retired = current_.exchange(next.release(), std::memory_order_seq_cst);
+    epochs_.Retire([retired] { delete retired; });
+    return number;
+}
+
+uint64_t VersionedGraph::version() const
+{
+    return snapshot().version();
+}
+
+size_t VersionedGraph::retiredVersions()
+{
+    return epochs_.Reclaim();
+}
+
+std::unique_ptr<VersionedGraph::Version> VersionedGraph::fold(const Version &version)
+{
+    const int n = version.base.vertices();
+    br::HugeVector<int64_t> offsets(static_cast<size_t>(n) + 1, 0);
+    br::HugeVector<int> targets(static_cast<size_t>(version.edges));
+    // Блоки копируются целиком: их строки уже лежат подряд
+    parallelFor(0, version.blocks.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t block = chunkStart; block < chunkEnd; ++block) {
+            const int first = static_cast<int>(block) * BLOCK_SIZE;
+            const int last = std::min(n, first + BLOCK_SIZE);
+            const Block *b = version.blocks[block].get();
+            for (int v = first; v < last; ++v) {
+                offsets[v + 1] = b == nullptr ? static_cast<int64_t>(version.base.neighbors(v).size())
+                                              : b->offsets[v - first + 1] - b->offsets[v - first];
+            }
+        }
+    });
+    for (int v = 0; v < n; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    parallelFor(0, version.blocks.size(), [&](size_t chunkStart, size_t chunkEnd, size_t) {
+        for (size_t block = chunkStart; block < chunkEnd; ++block) {
+            const int first = static_cast<int>(block) * BLOCK_SIZE;
+            const int last = std::min(n, first + BLOCK_SIZE);
+            if (const Block *b = version.blocks[block].get()) {
+                std::copy(b->targets.begin(), b->targets.end(), targets.begin() + offsets[first]);
+                continue;
+            }
+            for (int v = first; v < last; ++v) {
+                auto row = version.base.neighbors(v);
+                std::copy(row.begin(), row.end(), targets.begin() + offsets[v]);
+            }
+        }
+    });
+    return std::make_unique<Version>(Version{version.number, Graph(n, std::move(offsets), std::move(targets)),
+                                             std::vector<std::shared_ptr<const Block>>(version.blocks.size()),
+                                             version.edges, 0});
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "DynamicGraph.h"
+#include "Graph.h"
+#include "bedrock.h"
+
+// Граф с версиями (MVCC): обходы читают закрепленный снимок, пока писатель применяет пакеты обновлений.
+// Версия - базовый CSR плюс таблица блоков по BLOCK_SIZE вершин: блок, задетый хоть одним обновлением,
+// хранит свои строки отдельным маленьким CSR, остальные строки читаются из базы. Новая версия копирует
+// только таблицу указателей и задетые блоки, прежние версии не меняются. Снимок закрепляется через
+// br::EpochDomain, версия удаляется, когда ее не держит ни один снимок. Писатели сериализуются между собой.
+// Граф ориентированный, без весов и входящих ребер
+class VersionedGraph {
+    struct Block;
+    struct Version;
+
+public:
+    static constexpr int BLOCK_SIZE = 1024;
+
+    // Неизменяемый вид одной версии. Не должен пережить VersionedGraph
+    class Snapshot {
+    public:
+        [[nodiscard]] uint64_t version() const;
+        [[nodiscard]] int vertices() const;
+        [[nodiscard]] int64_t edges() const;
+
+        [[nodiscard]] std::span<const int> neighbors(int vertex) const
+        {
+            const Block *block = version_->blocks[vertex / BLOCK_SIZE].get();
+            if (block == nullptr)
+                return version_->base.neighbors(vertex);
+            int i = vertex % BLOCK_SIZE;
+            return std::span<const int>(block->targets).subspan(block->offsets[i],
+                                                                block->offsets[i + 1] - block->offsets[i]);
+        }
+
+        // Параллельный BFS по снимку, как parallelTraverseBFS
+        [[nodiscard]] BfsResult bfs(int startVertex, const br::StopToken &stop = {}) const;
+
+    private:
+        friend class VersionedGraph;
+
+        Snapshot(br::EpochDomain::Guard guard, const Version *version);
+
+        br::EpochDomain::Guard guard_;
+        const Version *version_;
+    };
+
+    explicit VersionedGraph(Graph base);
+    ~VersionedGraph();
+    VersionedGraph(const VersionedGraph &) = delete;
+    VersionedGraph &operator=(const VersionedGraph &) = delete;
+
+    // Закрепляет текущую версию: CAS в слоте эпохи и одна загрузка указателя
+    [[nodiscard]] Snapshot snapshot() const;
+    // Применяет пакет (обновления одной вершины - в порядке пакета) и публикует новую версию, возвращает ее
+    // номер. Повторная вставка и удаление несуществующего ребра ничего не меняют, как в DynamicGraph::apply.
+    // Когда в блоках набирается больше 1/FOLD_FRACTION ребер базы, версия сворачивается в новый CSR
+    uint64_t apply(std::span<const EdgeUpdate> batch);
+    [[nodiscard]] uint64_t version() const;
+    // Сколько старых версий еще ждут, пока их отпустят снимки
+    size_t retiredVersions();
+
+private:
+    static constexpr int64_t FOLD_FRACTION = 4;
+
+    // Строки вершин блока: offsets[i]..offsets[i + 1] в targets
+    struct Block {
+        std::vector<int64_t> offsets;
+        std::vector<int> targets;
+    };
+
+    struct Version {
+        uint64_t number = 0;
+        Graph base;
+        std::vector<std::shared_ptr<const Block>> blocks; // nullptr - строки блока в базе
+        int64_t edges = 0;
+        int64_t blockEdges = 0; // ребер, хранящихся в блоках
+    };
+
+    static std::unique_ptr<Version> fold(const Version &version);
+
+    mutable br::EpochDomain epochs_;
+    std::atomic<const Version *> current_;
+    std::mutex writer_;
+};
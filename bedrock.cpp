@@ -1,7 +1,127 @@
 #include "bedrock.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <unordered_map>
+
+#include <sys/mman.h>
+
 
 namespace br {
+namespace {
+enum class PageKind : uint8_t { HUGETLB = 0, TRANSPARENT, SMALL };
+
+struct LargeMapping {
+    PageKind kind;
+    size_t length;
+};
+
+bool hugePagesFromEnvironment()
+{
+    const char *env = std::getenv("HUGE_PAGES");
+    return env == nullptr || std::string_view(env) != "0";
+}
+
+std::atomic<bool> hugePagesEnabled{hugePagesFromEnvironment()};
+
+// Вид страниц каждого живого отображения: режим мог смениться между выделением и освобождением.
+// Больших массивов немного, так что общая блокировка тут не мешает. Таблица не разрушается:
+// статические массивы могут освобождаться уже после нее
+Mutex<std::unordered_map<void *, LargeMapping>> &largeMappings()
+{
+    static auto *mappings = new Mutex<std::unordered_map<void *, LargeMapping>>();
+    return *mappings;
+}
+
+size_t mappedLength(size_t bytes)
+{
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+void *mapLarge(size_t length, PageKind &kind)
+{
+    bool huge = hugePagesEnabled.load(std::memory_order_relaxed);
+    if (huge) {
+        void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            kind = PageKind::HUGETLB;
+            return data;
+        }
+    }
+    // Запас в одну страницу, чтобы выровнять начало на 2 МБ: иначе THP не сможет покрыть края
+    void *raw = mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto address = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (address + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    size_t head = aligned - address;
+    if (head != 0) {
+        munmap(raw, head);
+    }
+    if (head != HUGE_PAGE_SIZE) {
+        munmap(reinterpret_cast<void *>(aligned + length), HUGE_PAGE_SIZE - head);
+    }
+    auto *data = reinterpret_cast<void *>(aligned);
+    madvise(data, length, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    kind = huge ? PageKind::TRANSPARENT : PageKind::SMALL;
+    return data;
+}
+} // namespace
+
+void *AllocateLarge(size_t bytes)
+{
+    if (bytes < HUGE_PAGE_SIZE) {
+        return ::operator new(bytes);
+    }
+    PageKind kind;
+    size_t length = mappedLength(bytes);
+    void *data = mapLarge(length, kind);
+    largeMappings().Lock()->emplace(data, LargeMapping{kind, length});
+    return data;
+}
+
+void FreeLarge(void *data, size_t bytes) noexcept
+{
+    if (bytes < HUGE_PAGE_SIZE) {
+        ::operator delete(data);
+        return;
+    }
+    largeMappings().Lock()->erase(data);
+    munmap(data, mappedLength(bytes));
+}
+
+void SetHugePages(bool enabled)
+{
+    hugePagesEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool HugePagesEnabled()
+{
+    return hugePagesEnabled.load(std::memory_order_relaxed);
+}
+
+HugePageUsage CurrentHugePageUsage()
+{
+    HugePageUsage usage;
+    for (const auto &[data, mapping] : *largeMappings().Lock()) {
+        switch (mapping.kind) {
+            case PageKind::HUGETLB:
+                usage.hugetlbBytes += mapping.length;
+                break;
+            case PageKind::TRANSPARENT:
+                usage.transparentBytes += mapping.length;
+                break;
+            case PageKind::SMALL:
+                usage.smallPageBytes += mapping.length;
+                break;
+        }
+    }
+    return usage;
+}
+
 ThreadPool::ThreadPool(std::size_t num_threads)
 {
     threads_.reserve(num_threads);
@@ -48,4 +168,106 @@ void WaitGroup::Wait()
     --waiters_;
 }
 
+StopReason StopToken::Reason() const
+{
+    for (State *state = state_.get(); state != nullptr; state = state->parent.get()) {
+        auto reason = state->reason.load(std::memory_order_relaxed);
+        if (reason != StopReason::NONE) {
+            return reason;
+        }
+        if (state->deadline != Clock::time_point::max() && Clock::now() >= state->deadline) {
+            state->reason.store(StopReason::DEADLINE, std::memory_order_relaxed);
+            return StopReason::DEADLINE;
+        }
+    }
+    return StopReason::NONE;
+}
+
+StopSource::StopSource() : state_(std::make_shared<StopToken::State>()) {}
+
+StopSource::StopSource(Clock::time_point deadline) : StopSource()
+{
+    state_->deadline = deadline;
+}
+
+StopSource::StopSource(const StopToken &parent, Clock::time_point deadline) : StopSource(deadline)
+{
+    state_->parent = parent.state_;
+}
+
+void StopSource::RequestStop()
+{
+    auto expected = StopReason::NONE;
+    state_->reason.compare_exchange_strong(expected, StopReason::CANCELLED, std::memory_order_relaxed);
+}
+
+StopToken StopSource::Token() const
+{
+    return StopToken(state_);
+}
+
+EpochDomain::~EpochDomain()
+{
+    for (auto &[epoch, deleter] : *retired_.Lock()) {
+        deleter();
+    }
+}
+
+EpochDomain::Guard EpochDomain::Pin()
+{
+    thread_local size_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    for (size_t attempt = 1;; ++attempt) {
+        auto &slot = slots_[hint % SLOTS].epoch;
+        uint64_t expected = IDLE;
+        // seq_cst: слот должен стать виден писателю раньше, чем читатель загрузит указатель на версию.
+        // Устаревшая эпоха в слоте безопасна: она только дольше держит старые версии
+        if (slot.load(std::memory_order_relaxed) == IDLE &&
+            slot.compare_exchange_strong(expected, epoch_.load(std::memory_order_seq_cst),
+                                         std::memory_order_seq_cst)) {
+            return Guard(&slot);
+        }
+        ++hint;
+        if (attempt % SLOTS == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void EpochDomain::Retire(std::move_only_function<void()> deleter)
+{
+    // Новая версия уже опубликована: кто закрепится с эпохой не меньше этой, старую не увидит
+    uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired_.Lock()->emplace_back(epoch, std::move(deleter));
+    Reclaim();
+}
+
+size_t EpochDomain::Reclaim()
+{
+    uint64_t oldest = UINT64_MAX;
+    for (const auto &slot : slots_) {
+        uint64_t pinned = slot.epoch.load(std::memory_order_seq_cst);
+        if (pinned != IDLE && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+    std::vector<std::move_only_function<void()>> ready;
+    size_t waiting;
+    {
+        auto retired = retired_.Lock();
+        auto it = std::partition(retired->begin(), retired->end(), [&](const auto &entry) {
+            return entry.first > oldest;
+        });
+        for (auto entry = it; entry != retired->end(); ++entry) {
+            ready.push_back(std::move(entry->second));
+        }
+        retired->erase(it, retired->end());
+        waiting = retired->size();
+    }
+    // Удаление вне блокировки: деструктор версии может быть дорогим
+    for (auto &deleter : ready) {
+        deleter();
+    }
+    return waiting;
+}
+
 }
\ No newline at end of file
@@ -3,10 +3,22 @@
 
 #include <optional>
 #include <queue>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <memory>
 #include <type_traits>
 #include <mutex>
 #include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace br {
 template <typename T, typename MutexT = std::mutex>
@@ -203,5 +215,299 @@ private:
     std::condition_variable cv_;
 };
 
+enum class StopReason : uint8_t { NONE = 0, CANCELLED, DEADLINE };
+
+// Дешево опрашиваемый признак остановки: флаг отмены, дедлайн и, если есть, родительский токен.
+// Пустой токен никогда не останавливается
+class StopToken final {
+    friend class StopSource;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    StopToken() = default;
+
+    bool StopRequested() const
+    {
+        return Reason() != StopReason::NONE;
+    }
+
+    StopReason Reason() const;
+
+private:
+    struct State {
+        std::atomic<StopReason> reason{StopReason::NONE};
+        Clock::time_point deadline = Clock::time_point::max();
+        std::shared_ptr<State> parent;
+    };
+
+    explicit StopToken(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<State> state_;
+};
+
+class StopSource final {
+public:
+    using Clock = StopToken::Clock;
+
+    StopSource();
+    explicit StopSource(Clock::time_point deadline);
+    // Останавливается сам по себе или вместе с parent
+    explicit StopSource(const StopToken &parent, Clock::time_point deadline = Clock::time_point::max());
+
+    void RequestStop();
+    StopToken Token() const;
+
+private:
+    std::shared_ptr<StopToken::State> state_;
+};
+
+// Большие массивы (от HUGE_PAGE_SIZE байт) на страницах по 2 МБ: случайные обращения BFS к строкам, visited
+// и фронту иначе упираются в промахи dTLB. Сначала mmap с MAP_HUGETLB из зарезервированного пула ядра, без него -
+// обычное отображение, выровненное на 2 МБ, с madvise(MADV_HUGEPAGE) для прозрачных huge pages. Мелкие блоки
+// идут через operator new. HUGE_PAGES=0 в окружении или SetHugePages(false) оставляют новые большие массивы
+// на обычных страницах (MADV_NOHUGEPAGE), чтобы было с чем сравнить
+constexpr size_t HUGE_PAGE_SIZE = size_t{2} << 20;
+
+// Живые отображения AllocateLarge по видам страниц. transparentBytes - только запрошенные через madvise:
+// сколько из них ядро действительно собрало в huge pages, видно по AnonHugePages в /proc/meminfo
+struct HugePageUsage {
+    size_t hugetlbBytes = 0;
+    size_t transparentBytes = 0;
+    size_t smallPageBytes = 0;
+};
+
+void *AllocateLarge(size_t bytes);
+void FreeLarge(void *data, size_t bytes) noexcept;
+void SetHugePages(bool enabled);
+bool HugePagesEnabled();
+HugePageUsage CurrentHugePageUsage();
+
+template <typename T>
+class HugePageAllocator {
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Over-aligned types are not supported");
+
+public:
+    using value_type = T;
+
+    HugePageAllocator() = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(AllocateLarge(count * sizeof(T)));
+    }
+
+    void deallocate(T *data, size_t count) noexcept
+    {
+        FreeLarge(data, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U> &) const noexcept
+    {
+        return true;
+    }
+};
+
+template <typename T>
+using HugeVector = std::vector<T, HugePageAllocator<T>>;
+
+// Ленивая последовательность на корутинах (подмножество std::generator, которого еще нет в libstdc++ 12).
+// Тело корутины выполняется только при продвижении итератора, значения отдаются по значению
+template <typename T>
+class Generator final {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr exception;
+
+        Generator get_return_object()
+        {
+            return Generator(Handle::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always yield_value(T v)
+        {
+            value.emplace(std::move(v));
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception()
+        {
+            exception = std::current_exception();
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Iterator final {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        explicit Iterator(Handle handle) : handle_(handle) {}
+
+        const T &operator*() const
+        {
+            return *handle_.promise().value;
+        }
+
+        Iterator &operator++()
+        {
+            Advance(handle_);
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const
+        {
+            return !handle_ || handle_.done();
+        }
+
+    private:
+        Handle handle_;
+    };
+
+    Generator(Generator &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    Generator &operator=(Generator &&other) noexcept
+    {
+        if (this != &other) {
+            Reset();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    ~Generator()
+    {
+        Reset();
+    }
+
+    // У перемещенного генератора корутины нет: он пуст, begin() == end()
+    Iterator begin()
+    {
+        if (handle_) {
+            Advance(handle_);
+        }
+        return Iterator(handle_);
+    }
+
+    std::default_sentinel_t end() const noexcept
+    {
+        return {};
+    }
+
+private:
+    explicit Generator(Handle handle) : handle_(handle) {}
+
+    static void Advance(Handle handle)
+    {
+        handle.promise().value.reset();
+        handle.resume();
+        if (handle.promise().exception) {
+            std::rethrow_exception(std::exchange(handle.promise().exception, {}));
+        }
+    }
+
+    void Reset()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    Handle handle_;
+};
+
+// Отложенное освобождение по эпохам в стиле RCU. Читатель закрепляет текущую эпоху (Pin) на время работы
+// с разделяемой версией данных, писатель, опубликовав новую версию, отдает старую в Retire: она удаляется,
+// когда уйдут все читатели, закрепившиеся раньше. Pin - один CAS в собственной линии кэша слота,
+// без общего счетчика ссылок. Одновременно закрепиться могут не больше SLOTS читателей, остальные ждут
+class EpochDomain final {
+public:
+    class Guard final {
+        friend class EpochDomain;
+
+    public:
+        Guard(Guard &&guard) noexcept : slot_(std::exchange(guard.slot_, nullptr)) {}
+
+        Guard &operator=(Guard &&guard) noexcept
+        {
+            if (this != &guard) {
+                Release();
+                slot_ = std::exchange(guard.slot_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Guard()
+        {
+            Release();
+        }
+
+    private:
+        explicit Guard(std::atomic<uint64_t> *slot) : slot_(slot) {}
+
+        void Release()
+        {
+            if (slot_ != nullptr) {
+                slot_->store(IDLE, std::memory_order_release);
+            }
+        }
+
+        std::atomic<uint64_t> *slot_;
+    };
+
+    static constexpr size_t SLOTS = 128;
+
+    EpochDomain() = default;
+    EpochDomain(EpochDomain &&) noexcept = delete;
+    EpochDomain &operator=(EpochDomain &&) noexcept = delete;
+    // Удаляет все отложенное: закрепленных читателей к этому моменту быть не должно
+    ~EpochDomain();
+
+    Guard Pin();
+    void Retire(std::move_only_function<void()> deleter);
+    // Удаляет то, что уже никто не может видеть, и возвращает, сколько еще ждет
+    size_t Reclaim();
+
+private:
+    static constexpr uint64_t IDLE = 0;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    std::atomic<uint64_t> epoch_{1};
+    std::array<Slot, SLOTS> slots_;
+    Mutex<std::vector<std::pair<uint64_t, std::move_only_function<void()>>>> retired_;
+};
+
 } // namespace br
 #endif // BEDROCK_H
@@ -1,10 +1,66 @@
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <thread>
 #include <vector>
+#include "Betweenness.h"
+#include "Components.h"
+#include "DynamicGraph.h"
+#include "EdgeStream.h"
 #include "Graph.h"
+#include "NeighborScan.h"
+#include "PartitionedBfs.h"
+#include "Prefetch.h"
+#include "QueryEngine.h"
 #include "RandomGraphGenerator.h"
+#include "ReplicatedGraph.h"
+#include "SemiExternalGraph.h"
+#include "ShortestPaths.h"
+#include "VersionedGraph.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Аппаратный счетчик событий текущего потока через perf_event (промахи LLC, dTLB); без доступа к счетчикам
+// (виртуалка, perf_event_paranoid) value() пуст
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    PerfCounter(const PerfCounter &) = delete;
+    PerfCounter &operator=(const PerfCounter &) = delete;
+    ~PerfCounter()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    std::optional<long long> value() const
+    {
+        long long count = 0;
+        if (fd_ < 0 || read(fd_, &count, sizeof(count)) != sizeof(count))
+            return std::nullopt;
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+static constexpr uint64_t DTLB_LOAD_MISSES = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
 
 static long long executeSerialBfsAndGetTime(Graph &g)
 {
@@ -22,11 +78,329 @@ static long long executeParallelBfsAndGetTime(Graph &g)
     return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 }
 
+static long long executeDirectionOptimizingBfsAndGetTime(Graph &g)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto distances = g.directionOptimizingBFS(0);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+static long long executeAsyncBfsAndGetTime(Graph &g)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto distances = g.asyncBFS(0);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+// Подбор дистанций предвыборки на последовательном обходе, где счетчик промахов точен.
+// Лучший вариант остается включенным для всех дальнейших замеров
+static void tunePrefetch(Graph &g, std::ofstream &fw)
+{
+    const std::vector<PrefetchDistances> candidates = {{0, 0}, {2, 1}, {4, 2}, {8, 2}, {8, 4}, {16, 4}, {32, 8}};
+    PerfCounter misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    PrefetchDistances best = prefetchDistances();
+    long long bestTime = -1;
+    fw << "Prefetch tuning on " << g.vertices() << " vertices (row,visited: ms, LLC misses)";
+    for (auto distances : candidates) {
+        setPrefetchDistances(distances);
+        auto before = misses.value();
+        long long time = executeSerialBfsAndGetTime(g);
+        auto after = misses.value();
+        fw << "\n" << distances.row << ',' << distances.visited << ": " << time << ", ";
+        if (before && after)
+            fw << *after - *before;
+        else
+            fw << "n/a";
+        if (bestTime < 0 || time < bestTime) {
+            bestTime = time;
+            best = distances;
+        }
+    }
+    setPrefetchDistances(best);
+    fw << "\nChosen: " << best.row << ',' << best.visited << "\n--------\n";
+    fw.flush();
+}
+
+// Ускорение относительно последовательного обхода на плоской очереди, он и есть базовая линия
+static double speedup(long long serialTime, long long time)
+{
+    return static_cast<double>(serialTime) / static_cast<double>(std::max(time, 1LL));
+}
+
+// Цена обратного CSR относительно прямого, чтобы было видно, стоит ли его включать
+static void reportInEdges(const Graph &g, std::ofstream &fw)
+{
+    Graph reverse = g;
+    InEdgeStats stats = reverse.buildInEdges();
+    auto forwardBytes = static_cast<double>(sizeof(int64_t) * (static_cast<size_t>(g.vertices()) + 1) +
+                                            sizeof(int) * static_cast<size_t>(g.edges()));
+    fw << "\nIn-edges: " << static_cast<double>(stats.bytes) / (1024 * 1024) << " MiB ("
+       << 100.0 * static_cast<double>(stats.bytes) / forwardBytes << "% of out-edges), built in "
+       << stats.buildTime.count() << " ms";
+}
+
+static constexpr int HUGE_PAGE_TEST_SIZE = 20000000;
+
+// Одна и та же последовательная BFS по двум копиям графа: на обычных страницах и на huge pages.
+// Обход выделяет visited и очередь в том же режиме, что и копия
+static void reportHugePages(const Graph &g, std::ofstream &fw)
+{
+    const bool enabled = br::HugePagesEnabled();
+    fw << "\nHuge pages (ms, dTLB load misses):";
+    for (bool huge : {false, true}) {
+        br::SetHugePages(huge);
+        auto usageBefore = br::CurrentHugePageUsage();
+        br::HugeVector<int64_t> offsets(static_cast<size_t>(g.vertices()) + 1);
+        br::HugeVector<int> targets(static_cast<size_t>(g.edges()));
+        for (int v = 0; v < g.vertices(); ++v) {
+            auto row = g.neighbors(v);
+            std::copy(row.begin(), row.end(), targets.begin() + g.edgeIndex(v));
+            offsets[v + 1] = g.edgeIndex(v) + static_cast<int64_t>(row.size());
+        }
+        Graph copy(g.vertices(), std::move(offsets), std::move(targets));
+        auto usage = br::CurrentHugePageUsage();
+        usage.hugetlbBytes -= usageBefore.hugetlbBytes;
+        usage.transparentBytes -= usageBefore.transparentBytes;
+
+        PerfCounter tlbMisses(PERF_TYPE_HW_CACHE, DTLB_LOAD_MISSES);
+        auto before = tlbMisses.value();
+        long long time = executeSerialBfsAndGetTime(copy);
+        auto after = tlbMisses.value();
+        fw << "\n" << (huge ? "2 MB pages: " : "4 KB pages: ") << time << ", ";
+        if (before && after)
+            fw << *after - *before;
+        else
+            fw << "n/a";
+        if (huge)
+            fw << " (hugetlb " << usage.hugetlbBytes / (1024 * 1024) << " MiB, THP advised "
+               << usage.transparentBytes / (1024 * 1024) << " MiB)";
+    }
+    br::SetHugePages(enabled);
+}
+
+static constexpr int NUMA_TEST_SIZE = 20000000;
+
+// Параллельный BFS по общему графу и по репликам на узлах NUMA, плюс цена реплик в памяти
+static void reportNumaReplicas(Graph &g, std::ofstream &fw)
+{
+    ReplicatedGraph replicated(g);
+    auto start = std::chrono::steady_clock::now();
+    auto distances = replicated.bfs(0);
+    auto end = std::chrono::steady_clock::now();
+    long long replicatedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    fw << "\nNUMA nodes: " << replicated.replicas() << ", parallel " << executeParallelBfsAndGetTime(g)
+       << ", replicated " << replicatedTime << ", replicas take "
+       << static_cast<double>(replicated.overheadBytes()) / (1024 * 1024) << " MiB";
+}
+
+static constexpr int PARTITION_TEST_SIZE = 2000000;
+static constexpr int PARTITION_PROCESSES = 4;
+
+// Одни и те же процессы в 1D- и 2D-сетке: время обхода и сколько байт фронта прошло между ними
+static void reportPartitionedBfs(const Graph &g, std::ofstream &fw)
+{
+    for (auto grid : {PartitionGrid::oneD(PARTITION_PROCESSES), PartitionGrid::twoD(PARTITION_PROCESSES)}) {
+        auto result = partitionedBfs(g, 0, grid);
+        fw << "\nPartitioned " << grid.rows << "x" << grid.cols << ": " << result.traversalTime.count() << ", "
+           << result.messages << " messages, " << static_cast<double>(result.messageBytes) / (1024 * 1024)
+           << " MiB (" << static_cast<double>(result.uncompressedBytes) / (1024 * 1024) << " MiB as int32 lists)";
+    }
+}
+
+static constexpr int EXTERNAL_TEST_SIZE = 2000000;
+
+// Строки соседей читаются с диска: время против BFS в памяти и сколько байт пришлось прочитать ради строк фронта
+static void reportSemiExternal(Graph &g, std::ofstream &fw)
+{
+    const std::string path = "tmp/external.bin";
+    g.save(path);
+    {
+        SemiExternalGraph external(path);
+        auto start = std::chrono::steady_clock::now();
+        auto result = external.bfs(0);
+        auto end = std::chrono::steady_clock::now();
+        fw << "\nSemi-external BFS (" << (external.directIo() ? "direct I/O" : "page cache") << "): "
+           << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << ", in memory "
+           << executeParallelBfsAndGetTime(g) << ", " << result.reads << " reads, "
+           << static_cast<double>(result.bytesRead) / (1024 * 1024) << " MiB read for "
+           << static_cast<double>(result.rowBytes) / (1024 * 1024) << " MiB of rows";
+    }
+    std::filesystem::remove(path);
+}
+
+static constexpr int STREAM_TEST_SIZE = 2000000;
+
+// Реберно-центричный BFS по последовательным разделам ребер против обычного параллельного BFS по строкам
+static void reportEdgeStream(Graph &g, std::ofstream &fw)
+{
+    auto stream = EdgeStream::fromGraph(g);
+    auto start = std::chrono::steady_clock::now();
+    auto distances = stream.bfs(0);
+    auto end = std::chrono::steady_clock::now();
+    fw << "\nEdge-centric streaming BFS (" << stream.partitions() << " partitions): "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << ", vertex-centric parallel "
+       << executeParallelBfsAndGetTime(g);
+}
+
+static constexpr int COMPONENTS_TEST_SIZE = 1000000;
+static constexpr int HISTOGRAM_ROWS = 8;
+
+// Время слабых и сильных компонент, их число и гистограмма размеров: самые крупные размеры первыми
+static void reportComponents(const Graph &g, std::ofstream &fw)
+{
+    ComponentAnalyzer analyzer;
+    for (bool strong : {false, true}) {
+        auto start = std::chrono::steady_clock::now();
+        Components components = strong ? analyzer.stronglyConnected(g) : analyzer.weaklyConnected(g);
+        auto end = std::chrono::steady_clock::now();
+        fw << "\n" << (strong ? "SCC: " : "WCC: ")
+           << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << ", "
+           << components.count() << " components, sizes:";
+        int rows = 0;
+        for (auto it = components.sizeHistogram.rbegin(); it != components.sizeHistogram.rend(); ++it) {
+            if (rows++ == HISTOGRAM_ROWS) {
+                fw << " ...";
+                break;
+            }
+            fw << " " << it->first << " x" << it->second;
+        }
+    }
+}
+
+static constexpr int BETWEENNESS_TEST_SIZE = 100000;
+static constexpr int BETWEENNESS_SOURCES = 64;
+static constexpr uint64_t BETWEENNESS_SEED = 11;
+
+// Оценка центральности по случайным источникам: время и самая центральная вершина.
+// Источники из своего генератора, как корни пакета запросов, чтобы не сдвигать графы следующих размеров
+static void reportBetweenness(const Graph &g, std::ofstream &fw)
+{
+    std::mt19937_64 r(BETWEENNESS_SEED);
+    auto start = std::chrono::steady_clock::now();
+    auto centrality = BetweennessAnalyzer().sampled(g, r, BETWEENNESS_SOURCES);
+    auto end = std::chrono::steady_clock::now();
+    auto top = std::max_element(centrality.begin(), centrality.end());
+    fw << "\nSampled betweenness, " << BETWEENNESS_SOURCES << " sources: "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << ", max " << *top
+       << " at vertex " << top - centrality.begin();
+}
+
+static constexpr int MAX_EDGE_WEIGHT = 255;
+
+static long long executeDeltaSteppingAndGetTime(Graph &g)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto distances = ShortestPaths().deltaStepping(g, 0);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+static constexpr int UPDATE_BATCH = 10000;
+static constexpr int UPDATE_ROUNDS = 10;
+
+// Пакеты случайных вставок и удалений: время apply и починки BFS-дерева против полного BFS после каждого пакета
+static void reportDynamicUpdates(const Graph &g, std::mt19937_64 &r, std::ofstream &fw)
+{
+    DynamicGraph dynamic(g);
+    IncrementalBfs tree(dynamic, 0);
+    std::uniform_int_distribution<int> vertexDist(0, g.vertices() - 1);
+    long long applyTime = 0;
+    long long repairTime = 0;
+    long long fullTime = 0;
+    size_t recomputed = 0;
+    for (int round = 0; round < UPDATE_ROUNDS; ++round) {
+        std::vector<EdgeUpdate> batch(UPDATE_BATCH);
+        for (auto &update : batch) {
+            int src = vertexDist(r);
+            auto row = dynamic.base().neighbors(src);
+            // Удаляем ребра базы, иначе почти все удаления пришлись бы на несуществующие ребра
+            if (r() % 2 == 0 && !row.empty())
+                update = {EdgeUpdate::Kind::REMOVE, src, row[r() % row.size()]};
+            else
+                update = {EdgeUpdate::Kind::INSERT, src, vertexDist(r)};
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto applied = dynamic.apply(batch);
+        auto applyEnd = std::chrono::steady_clock::now();
+        recomputed += tree.update(applied);
+        auto repairEnd = std::chrono::steady_clock::now();
+        IncrementalBfs full(dynamic, 0);
+        auto fullEnd = std::chrono::steady_clock::now();
+        applyTime += std::chrono::duration_cast<std::chrono::milliseconds>(applyEnd - start).count();
+        repairTime += std::chrono::duration_cast<std::chrono::milliseconds>(repairEnd - applyEnd).count();
+        fullTime += std::chrono::duration_cast<std::chrono::milliseconds>(fullEnd - repairEnd).count();
+    }
+    fw << "\n" << UPDATE_ROUNDS << " batches of " << UPDATE_BATCH << " updates: apply " << applyTime
+       << ", incremental BFS " << repairTime << " (" << recomputed << " vertices recomputed), full BFS " << fullTime;
+}
+
+static constexpr int INGEST_TEST_SIZE = 1000000;
+
+// BFS по снимку в тишине и пока другой поток публикует версии пакетами UPDATE_BATCH: чтение не должно замедляться
+static void reportConcurrentIngest(const Graph &g, std::mt19937_64 &r, std::ofstream &fw)
+{
+    VersionedGraph versioned(g);
+    auto measure = [&] {
+        auto snapshot = versioned.snapshot();
+        auto start = std::chrono::steady_clock::now();
+        auto distances = snapshot.bfs(0);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    };
+    long long idleTime = measure();
+
+    std::vector<EdgeUpdate> batch(UPDATE_BATCH);
+    std::uniform_int_distribution<int> vertexDist(0, g.vertices() - 1);
+    for (auto &update : batch) {
+        update = {r() % 2 == 0 ? EdgeUpdate::Kind::INSERT : EdgeUpdate::Kind::REMOVE, vertexDist(r), vertexDist(r)};
+    }
+    std::atomic<bool> reading = true;
+    std::thread writer([&] {
+        while (reading.load(std::memory_order_relaxed)) {
+            versioned.apply(batch);
+        }
+    });
+    long long ingestTime = measure();
+    reading = false;
+    writer.join();
+    fw << "\nSnapshot BFS: idle " << idleTime << ", during ingest " << ingestTime << " (version "
+       << versioned.version() << ")";
+}
+
+static constexpr int QUERY_BATCH = 8;
+static constexpr int PREFETCH_TUNING_SIZE = 1000000;
+
+static constexpr uint64_t QUERY_SEED = 7;
+
+// Корни пакета берутся из своего генератора: общий r задает графы, и лишние вызовы сдвинули бы все следующие
+static long long executeQueryBatchAndGetTime(Graph &g)
+{
+    std::mt19937_64 r(QUERY_SEED);
+    std::uniform_int_distribution<int> rootDist(0, g.vertices() - 1);
+    std::vector<int> roots(QUERY_BATCH);
+    for (int &root : roots) {
+        root = rootDist(r);
+    }
+    QueryEngine engine(g);
+    auto start = std::chrono::steady_clock::now();
+    auto results = engine.run(roots);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
 int main()
 {
     try {
         std::vector<int> sizes       = {10, 100, 1000, 10000, 10000, 50000, 100000, 1000000, 2000000, 20000000};
         std::vector<int> connections = {50, 500, 5000, 50000, 100000, 1000000, 1000000, 10000000, 10000000, 50000000};
+        // Почти цепочка: сотни и тысячи уровней, как у дорожных графов
+        std::vector<int> sparseSizes       = {100000, 1000000, 2000000};
+        std::vector<int> sparseConnections = {110000, 1100000, 2200000};
+        // Неориентированные: каждое ребро хранится в обе стороны, bottom-up обходится без транспонирования
+        std::vector<int> undirectedSizes       = {100000, 1000000, 2000000};
+        std::vector<int> undirectedConnections = {500000, 5000000, 10000000};
 
         std::mt19937_64 r(42);
 
@@ -38,19 +412,45 @@ int main()
         }
 
         RandomGraphGenerator gen;
+        std::cout << "Neighbor scan kernel: " << scanKernelName() << '\n';
 
         for (size_t i = 0; i < sizes.size(); ++i) {
             std::cout << "--------------------------\n";
             std::cout << "Generating graph of size " << sizes[i] << " ... wait\n";
             Graph g = gen.generateGraph(r, sizes[i], connections[i]);
             std::cout << "Generation completed!\nStarting bfs\n";
+            if (sizes[i] == PREFETCH_TUNING_SIZE)
+                tunePrefetch(g, fw);
             long long serialTime = executeSerialBfsAndGetTime(g);
             long long parallelTime = executeParallelBfsAndGetTime(g);
+            long long asyncTime = executeAsyncBfsAndGetTime(g);
+            long long batchTime = executeQueryBatchAndGetTime(g);
 
 #if 1
             fw << "Times for " << sizes[i] << " vertices and " << connections[i] << " connections: ";
             fw << "\nSerial: " << serialTime;
             fw << "\nParallel: " << parallelTime;
+            fw << "\nAsync: " << asyncTime;
+            fw << "\nSpeedup over serial: parallel " << speedup(serialTime, parallelTime) << ", async "
+               << speedup(serialTime, asyncTime);
+            fw << "\nBatch of " << QUERY_BATCH << " queries: " << batchTime;
+            reportInEdges(g, fw);
+            if (sizes[i] == COMPONENTS_TEST_SIZE)
+                reportComponents(g, fw);
+            if (sizes[i] == BETWEENNESS_TEST_SIZE)
+                reportBetweenness(g, fw);
+            if (sizes[i] == INGEST_TEST_SIZE)
+                reportConcurrentIngest(g, r, fw);
+            if (sizes[i] == HUGE_PAGE_TEST_SIZE)
+                reportHugePages(g, fw);
+            if (sizes[i] == NUMA_TEST_SIZE)
+                reportNumaReplicas(g, fw);
+            if (sizes[i] == PARTITION_TEST_SIZE)
+                reportPartitionedBfs(g, fw);
+            if (sizes[i] == EXTERNAL_TEST_SIZE)
+                reportSemiExternal(g, fw);
+            if (sizes[i] == STREAM_TEST_SIZE)
+                reportEdgeStream(g, fw);
             fw << "\n--------\n";
             fw.flush();
 #else
@@ -60,6 +460,48 @@ int main()
 #endif
         }
 
+        for (size_t i = 0; i < sparseSizes.size(); ++i) {
+            std::cout << "--------------------------\n";
+            std::cout << "Generating high-diameter graph of size " << sparseSizes[i] << " ... wait\n";
+            Graph g = gen.generateGraph(r, sparseSizes[i], sparseConnections[i]);
+            std::cout << "Generation completed!\nStarting bfs\n";
+            long long serialTime = executeSerialBfsAndGetTime(g);
+            long long parallelTime = executeParallelBfsAndGetTime(g);
+            long long asyncTime = executeAsyncBfsAndGetTime(g);
+
+            fw << "High-diameter, " << sparseSizes[i] << " vertices and " << sparseConnections[i] << " connections: ";
+            fw << "\nSerial: " << serialTime;
+            fw << "\nParallel: " << parallelTime;
+            fw << "\nAsync: " << asyncTime;
+            fw << "\nSpeedup over serial: parallel " << speedup(serialTime, parallelTime) << ", async "
+               << speedup(serialTime, asyncTime);
+            reportDynamicUpdates(g, r, fw);
+            fw << "\n--------\n";
+            fw.flush();
+        }
+
+        for (size_t i = 0; i < undirectedSizes.size(); ++i) {
+            std::cout << "--------------------------\n";
+            std::cout << "Generating undirected graph of size " << undirectedSizes[i] << " ... wait\n";
+            Graph g = gen.generateSymmetricGraph(r, undirectedSizes[i], undirectedConnections[i]);
+            std::cout << "Generation completed!\nStarting bfs\n";
+            long long serialTime = executeSerialBfsAndGetTime(g);
+            long long parallelTime = executeParallelBfsAndGetTime(g);
+            long long hybridTime = executeDirectionOptimizingBfsAndGetTime(g);
+            Graph weighted = gen.generateWeights(g, r, MAX_EDGE_WEIGHT);
+            long long ssspTime = executeDeltaSteppingAndGetTime(weighted);
+
+            fw << "Undirected, " << undirectedSizes[i] << " vertices and " << undirectedConnections[i] << " edges: ";
+            fw << "\nSerial: " << serialTime;
+            fw << "\nParallel: " << parallelTime;
+            fw << "\nDirection-optimizing: " << hybridTime;
+            fw << "\nDelta-stepping, weights 1.." << MAX_EDGE_WEIGHT << ": " << ssspTime;
+            fw << "\nSpeedup over serial: parallel " << speedup(serialTime, parallelTime) << ", direction-optimizing "
+               << speedup(serialTime, hybridTime);
+            fw << "\n--------\n";
+            fw.flush();
+        }
+
         std::cout << "Done. Results in tmp/results.txt\n";
     } catch (const std::exception &ex) {
         std::cerr << "Exception: " << ex.what() << "\n";